@@ -4,110 +4,994 @@ Breaks a rational interval in the form a/b into its prime factorization.
 Numbers in "[>" are the powers of the prime factors
 and the numbers in "()" are the powers' respective primes.
 
+Given "-" or "-f file" instead of a ratio, every whitespace-separated ratio
+in standard input or the file is broken down, one result per line. Numbers
+below SPF_LIMIT are factored with a table of smallest prime factors built
+once, and the output is collected in a large buffer and written in big
+blocks.
+
+The numerator and denominator can each have up to BIG_LIMBS * 64 bits
+(over 150 digits). Anything the table can't handle has its small prime
+factors divided out and goes through a Miller-Rabin primality test, and
+composites are split with Brent's version of Pollard's rho. Numbers that
+fit in 64 bits do all of that in single words, and bigger ones use
+Montgomery multiplication on as many words as they need. Rho finds factors
+up to about 15 digits quickly; a composite with no factor that small is
+left whole with a warning on standard error.
+
+With "-l limit" or "-g 2.3.7.11" every ratio is instead written as a dense
+row of exponents over a fixed prime limit or subgroup, one "[a b c>" row
+per line, and ratios with any other prime are reported as outside the
+subgroup. Since only the subgroup's primes are needed, these are found by
+division alone. Adding "-b file" writes the rows to a binary file instead,
+laid out for loading with mmap:
+
+	bytes 0-63	header, see struct dense_header
+	primes_offset	the subgroup's primes, one uint64 each
+	data_offset	one column per prime, each column_stride bytes long and
+		holding an int8 or int16 exponent per row, in input order
+	flags_offset	one byte per row, DENSE_OUTSIDE or DENSE_INVALID if
+		the row couldn't be written and is left as zeros
+
+All offsets and strides are multiples of 64 bytes, and numbers are stored
+in the machine's own byte order.
+
 Written in 2023 or 2024 by Tristan Bay, public domain code
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 
-int max(int a, int b)
+#define SPF_LIMIT 1048576 // numbers below this are factored by table lookups
+#define BIG_LIMBS 8 // 64-bit words in the largest numerator or denominator
+#define MAX_FACTORS (BIG_LIMBS * 64) // room for every prime of n and d
+#define SMALL_PRIMES 168 // primes below 1000, divided out before anything else
+#define BIG_TRIAL 6542 // primes below 65536, tried on numbers over 64 bits
+#define RHO_BATCH 128 // differences multiplied together before taking a gcd
+#define RHO_LIMIT 4194304 // rho steps before a big number is left unsplit
+#define OUT_BUFFER 1048576 // bytes of output collected before writing
+#define IN_BUFFER 1048576 // bytes of input read at a time
+#define MAX_SUBGROUP 256 // primes in a dense subgroup
+#define DENSE_MAGIC "MONZODNS"
+#define DENSE_VERSION 1
+#define DENSE_OUTSIDE 1 // flag for a ratio with primes outside the subgroup
+#define DENSE_INVALID 2 // flag for a token that isn't a ratio
+
+typedef unsigned __int128 u128;
+
+unsigned int* spf; // smallest prime factor of each number below SPF_LIMIT
+unsigned int* primes; // primes below SPF_LIMIT, for larger trial divisions
+int prime_count;
+// x is divisible by the odd prime p exactly when x * inverse <= limit
+unsigned long small_inverse[SMALL_PRIMES], small_limit[SMALL_PRIMES];
+
+struct bignum // least significant word first, unused words are zero
+{
+	unsigned long w[BIG_LIMBS];
+};
+
+struct factor
+{
+	struct bignum p;
+	int exp;
+};
+
+struct montgomery // an odd modulus and the constants for multiplying mod it
+{
+	struct bignum m, r2, one; // r2 and one are R^2 and R mod m, R = 2^(64n)
+	unsigned long inv; // -1/m mod 2^64
+	int n; // words in m
+};
+
+// the first 64 bytes of a binary dense file; tempering-edos.c has a copy
+// that has to be kept the same
+struct dense_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t width; // bytes per exponent, 1 or 2
+	uint64_t rows;
+	uint32_t cols;
+	uint32_t reserved;
+	uint64_t primes_offset;
+	uint64_t data_offset;
+	uint64_t flags_offset;
+	uint64_t column_stride;
+};
+
+struct dense_rows // every row so far, kept until the file can be written
+{
+	short* exps; // row major, cols per row
+	unsigned char* flags;
+	unsigned long count, size;
+};
+
+unsigned long subgroup[MAX_SUBGROUP];
+int subgroup_size; // zero for ordinary sparse output
+struct dense_rows* dense; // not NULL when writing a binary file
+
+struct out_buffer
+{
+	char* data;
+	size_t len;
+	FILE* f;
+};
+
+unsigned long max(unsigned long a, unsigned long b)
 {
 	return (a > b) ? a : b;
 }
 
-int min(int a, int b)
+unsigned long min(unsigned long a, unsigned long b)
 {
 	return (a > b) ? b : a;
 }
 
-void simplify(int* n, int* d)
+unsigned long gcd(unsigned long a, unsigned long b)
 {
-	int a = max(*n, *d), b = min(*n, *d), gcd;
+	unsigned long t;
 	while (b != 0) {
-		gcd = a % b;
+		t = a % b;
 		a = b;
-		b = gcd;
+		b = t;
+	}
+	return a;
+}
+
+void simplify(unsigned long* n, unsigned long* d)
+{
+	unsigned long g = gcd(max(*n, *d), min(*n, *d));
+	*n /= g;
+	*d /= g;
+}
+
+void build_spf(void)
+{
+	spf = calloc(SPF_LIMIT, sizeof(unsigned int));
+	primes = malloc(SPF_LIMIT / 8 * sizeof(unsigned int));
+	for (unsigned int i = 2; i < SPF_LIMIT; ++i) {
+		if (spf[i])
+			continue;
+		*(primes + prime_count++) = i;
+		for (unsigned long j = (unsigned long)i * i; j < SPF_LIMIT; j += i)
+			if (!spf[j])
+				spf[j] = i;
+		spf[i] = i;
+	}
+	for (int i = 1; i < SMALL_PRIMES; ++i) {
+		unsigned long p = *(primes + i), inv = p;
+		for (int j = 0; j < 5; ++j)
+			inv *= 2 - p * inv;
+		small_inverse[i] = inv;
+		small_limit[i] = (unsigned long)-1 / p;
+	}
+}
+
+/* Numbers too big for one word. Only the Montgomery multiplication has to be
+fast, since everything else runs a few times per number. */
+
+int big_len(const struct bignum* a)
+{
+	int n = BIG_LIMBS;
+	while (n > 0 && !a->w[n - 1])
+		--n;
+	return n;
+}
+
+struct bignum big_from(unsigned long x)
+{
+	struct bignum a = { { x } };
+	return a;
+}
+
+_Bool big_is_small(const struct bignum* a, unsigned long x) // a == x
+{
+	return big_len(a) <= 1 && a->w[0] == x;
+}
+
+int big_cmp(const struct bignum* a, const struct bignum* b)
+{
+	for (int i = BIG_LIMBS - 1; i >= 0; --i)
+		if (a->w[i] != b->w[i])
+			return a->w[i] > b->w[i] ? 1 : -1;
+	return 0;
+}
+
+void big_sub(struct bignum* a, const struct bignum* b) // wraps if b > a
+{
+	unsigned long borrow = 0;
+	for (int i = 0; i < BIG_LIMBS; ++i) {
+		u128 t = (u128)a->w[i] - b->w[i] - borrow;
+		a->w[i] = (unsigned long)t;
+		borrow = (unsigned long)(t >> 64) ? 1 : 0;
+	}
+}
+
+struct bignum big_diff(const struct bignum* a, const struct bignum* b) // |a-b|
+{
+	struct bignum d = big_cmp(a, b) >= 0 ? *a : *b;
+	big_sub(&d, big_cmp(a, b) >= 0 ? b : a);
+	return d;
+}
+
+unsigned long big_shl1(struct bignum* a) // returns the bit shifted out
+{
+	unsigned long out = a->w[BIG_LIMBS - 1] >> 63;
+	for (int i = BIG_LIMBS - 1; i > 0; --i)
+		a->w[i] = (a->w[i] << 1) | (a->w[i - 1] >> 63);
+	a->w[0] <<= 1;
+	return out;
+}
+
+void big_shr(struct bignum* a, int bits) // 0 < bits < 64
+{
+	for (int i = 0; i < BIG_LIMBS - 1; ++i)
+		a->w[i] = (a->w[i] >> bits) | (a->w[i + 1] << (64 - bits));
+	a->w[BIG_LIMBS - 1] >>= bits;
+}
+
+unsigned long big_div_small(struct bignum* a, unsigned long d) // remainder
+{
+	unsigned long rem = 0;
+	for (int i = big_len(a) - 1; i >= 0; --i) {
+		u128 t = ((u128)rem << 64) | a->w[i];
+		a->w[i] = (unsigned long)(t / d);
+		rem = (unsigned long)(t % d);
 	}
-	gcd = a;
-	*n /= gcd;
-	*d /= gcd;
+	return rem;
 }
 
-int count_factors(int n, int d)
+struct bignum big_div(const struct bignum* a, const struct bignum* b) // a / b
 {
-	long t = (long)n * d;
-	_Bool divisible = false;
-	int count = 0;
-	for (long i = 2; i > 0 && t != 1; i += 2) {
-		while (t % i == 0) {
-			divisible = true;
-			t /= i;
+	struct bignum q = big_from(0), r = big_from(0);
+	for (int bit = big_len(a) * 64 - 1; bit >= 0; --bit) {
+		big_shl1(&r);
+		r.w[0] |= (a->w[bit / 64] >> (bit % 64)) & 1;
+		if (big_cmp(&r, b) >= 0) {
+			big_sub(&r, b);
+			q.w[bit / 64] |= 1UL << (bit % 64);
 		}
-		if (divisible) {
-			++count;
-			divisible = false;
+	}
+	return q;
+}
+
+struct bignum big_gcd(struct bignum a, struct bignum b) // b must be odd
+{
+	if (!big_len(&a))
+		return b;
+	while (!(a.w[0] & 1))
+		big_shr(&a, 1);
+	while (big_len(&b)) {
+		while (!(b.w[0] & 1))
+			big_shr(&b, 1);
+		if (big_cmp(&a, &b) > 0) {
+			struct bignum t = a;
+			a = b;
+			b = t;
 		}
-		if (i == 2)
-			--i;
+		big_sub(&b, &a);
 	}
-	return count;
+	return a;
 }
 
-void calc_monzo(int* factors, int* exponents, int f_count, int n, int d)
+// reads decimal digits into a, failing if there are none or too many
+_Bool big_parse(const char* s, const char** end, struct bignum* a)
 {
-	int count = 0;
-	for (int i = 2; n * d != 1 && i > 0; i += 2) {
-		if (n % i == 0) {
-			*(factors + count) = i;
-			*(exponents + count) = 0;
-			while (n % i == 0) {
-				n /= i;
-				++(*(exponents + count));
+	const char* start = s;
+	*a = big_from(0);
+	for (; *s >= '0' && *s <= '9'; ++s) {
+		unsigned long carry = *s - '0';
+		for (int i = 0; i < BIG_LIMBS; ++i) {
+			u128 t = (u128)a->w[i] * 10 + carry;
+			a->w[i] = (unsigned long)t;
+			carry = (unsigned long)(t >> 64);
+		}
+		if (carry)
+			return false;
+	}
+	*end = s;
+	return s != start;
+}
+
+void big_to_string(struct bignum a, char* s) // s needs 20 * BIG_LIMBS bytes
+{
+	char digits[20 * BIG_LIMBS];
+	int len = 0;
+	while (big_len(&a) > 1) { // 19 digits at a time until the rest fits a word
+		unsigned long chunk = big_div_small(&a, 10000000000000000000UL);
+		for (int i = 0; i < 19; ++i) {
+			digits[len++] = '0' + chunk % 10;
+			chunk /= 10;
+		}
+	}
+	unsigned long x = a.w[0];
+	do {
+		digits[len++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+	while (len)
+		*s++ = digits[--len];
+	*s = '\0';
+}
+
+void mont_init(struct montgomery* mt, const struct bignum* m)
+{
+	unsigned long inv = m->w[0]; // right to 3 bits, each step doubles that
+	for (int i = 0; i < 5; ++i)
+		inv *= 2 - m->w[0] * inv;
+	mt->inv = -inv;
+	mt->m = *m;
+	mt->n = big_len(m);
+	struct bignum x = big_from(1);
+	for (int i = 0; i < 128 * mt->n; ++i) { // doubling up to R, then R^2
+		if (big_shl1(&x) || big_cmp(&x, m) >= 0)
+			big_sub(&x, m);
+		if (i == 64 * mt->n - 1)
+			mt->one = x;
+	}
+	mt->r2 = x;
+}
+
+// a * b / R mod m, interleaving the multiplication and reduction word by word
+struct bignum mont_mul(const struct montgomery* mt, const struct bignum* a,
+	const struct bignum* b)
+{
+	unsigned long t[BIG_LIMBS + 2] = { 0 }, carry, k;
+	int n = mt->n;
+	u128 s;
+	for (int i = 0; i < n; ++i) {
+		carry = 0;
+		for (int j = 0; j < n; ++j) {
+			s = (u128)a->w[j] * b->w[i] + t[j] + carry;
+			t[j] = (unsigned long)s;
+			carry = (unsigned long)(s >> 64);
+		}
+		s = (u128)t[n] + carry;
+		t[n] = (unsigned long)s;
+		t[n + 1] = (unsigned long)(s >> 64);
+		k = t[0] * mt->inv;
+		s = (u128)k * mt->m.w[0] + t[0];
+		carry = (unsigned long)(s >> 64);
+		for (int j = 1; j < n; ++j) {
+			s = (u128)k * mt->m.w[j] + t[j] + carry;
+			t[j - 1] = (unsigned long)s;
+			carry = (unsigned long)(s >> 64);
+		}
+		s = (u128)t[n] + carry;
+		t[n - 1] = (unsigned long)s;
+		t[n] = t[n + 1] + (unsigned long)(s >> 64);
+	}
+	struct bignum r = big_from(0);
+	memcpy(r.w, t, n * sizeof(unsigned long));
+	if (t[n] || big_cmp(&r, &mt->m) >= 0) {
+		big_sub(&r, &mt->m);
+		memset(r.w + n, 0, (BIG_LIMBS - n) * sizeof(unsigned long));
+	}
+	return r;
+}
+
+// a * a / R + c mod m, the pseudorandom map for rho
+struct bignum mont_step(const struct montgomery* mt, const struct bignum* a,
+	const struct bignum* c)
+{
+	struct bignum r = mont_mul(mt, a, a);
+	unsigned long carry = 0;
+	for (int i = 0; i < BIG_LIMBS; ++i) {
+		u128 t = (u128)r.w[i] + c->w[i] + carry;
+		r.w[i] = (unsigned long)t;
+		carry = (unsigned long)(t >> 64);
+	}
+	if (carry || big_cmp(&r, &mt->m) >= 0)
+		big_sub(&r, &mt->m);
+	return r;
+}
+
+_Bool big_is_prime(const struct bignum* m) // Miller-Rabin for odd m > 2^64
+{
+	static const unsigned long bases[] = {
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53
+	};
+	struct montgomery mt;
+	mont_init(&mt, m);
+	struct bignum d = *m, minus_one = *m, x, base;
+	big_sub(&minus_one, &mt.one);
+	d.w[0] &= ~1UL;
+	int s = 0;
+	for (; !(d.w[0] & 1); ++s)
+		big_shr(&d, 1);
+	for (int i = 0; i < (int)(sizeof(bases) / sizeof(*bases)); ++i) {
+		base = big_from(bases[i]);
+		base = mont_mul(&mt, &base, &mt.r2);
+		x = mt.one;
+		for (int bit = big_len(&d) * 64 - 1; bit >= 0; --bit) {
+			x = mont_mul(&mt, &x, &x);
+			if ((d.w[bit / 64] >> (bit % 64)) & 1)
+				x = mont_mul(&mt, &x, &base);
+		}
+		if (!big_cmp(&x, &mt.one) || !big_cmp(&x, &minus_one))
+			continue;
+		int r = 1;
+		for (; r < s; ++r) {
+			x = mont_mul(&mt, &x, &x);
+			if (!big_cmp(&x, &minus_one))
+				break;
+		}
+		if (r == s)
+			return false;
+	}
+	return true;
+}
+
+// Brent's rho, returning a nontrivial factor of odd composite m, or 0 if
+// it has no factor small enough to find in RHO_LIMIT steps
+struct bignum big_rho(const struct bignum* m)
+{
+	struct montgomery mt;
+	mont_init(&mt, m);
+	struct bignum x, y, ys, q, c, g, diff;
+	long steps = 0;
+	for (unsigned long seed = 1;; ++seed) {
+		c = big_from(seed);
+		y = big_from(seed + 1);
+		q = mt.one;
+		g = big_from(1);
+		for (long r = 1; big_is_small(&g, 1); r *= 2) {
+			if ((steps += 2 * r) > RHO_LIMIT)
+				return big_from(0);
+			x = y;
+			for (long i = 0; i < r; ++i)
+				y = mont_step(&mt, &y, &c);
+			for (long k = 0; k < r && big_is_small(&g, 1); k += RHO_BATCH) {
+				ys = y;
+				for (long i = 0; i < RHO_BATCH && i < r - k; ++i) {
+					y = mont_step(&mt, &y, &c);
+					diff = big_diff(&x, &y);
+					q = mont_mul(&mt, &q, &diff);
+				}
+				g = big_gcd(q, mt.m);
 			}
-			++count;
-		} else if (d % i == 0) {
-			*(factors + count) = i;
-			*(exponents + count) = 0;
-			while (d % i == 0) {
-				d /= i;
-				--(*(exponents + count));
+		}
+		if (!big_cmp(&g, m)) { // the batch overshot, so redo it one at a time
+			do {
+				ys = mont_step(&mt, &ys, &c);
+				g = big_gcd(big_diff(&x, &ys), mt.m);
+			} while (big_is_small(&g, 1));
+		}
+		if (big_cmp(&g, m))
+			return g;
+	}
+}
+
+/* The same for numbers that fit in one word. */
+
+unsigned long mulmod(unsigned long a, unsigned long b, unsigned long m)
+{
+	if (m >> 32 == 0) // the product fits in a word, and word division is faster
+		return a * b % m;
+	return (unsigned long)((u128)a * b % m);
+}
+
+unsigned long powmod(unsigned long a, unsigned long e, unsigned long m)
+{
+	unsigned long r = 1;
+	for (a %= m; e; e >>= 1) {
+		if (e & 1)
+			r = mulmod(r, a, m);
+		a = mulmod(a, a, m);
+	}
+	return r;
+}
+
+unsigned long rho_step(unsigned long y, unsigned long c, unsigned long n)
+{
+	if (n >> 32 == 0)
+		return (y * y + c) % n;
+	return (unsigned long)(((u128)y * y + c) % n);
+}
+
+_Bool is_prime(unsigned long n) // Miller-Rabin, with bases exact for 64 bits
+{
+	static const unsigned long bases[] = {
+		2, 325, 9375, 28178, 450775, 9780504, 1795265022
+	};
+	static const unsigned long bases_32[] = { 2, 7, 61 }; // exact below 2^32
+	const unsigned long* base = n >> 32 ? bases : bases_32;
+	int base_count = n >> 32 ? 7 : 3;
+	if (n < SPF_LIMIT)
+		return n > 1 && *(spf + n) == n;
+	if (!(n & 1))
+		return false;
+	int s = __builtin_ctzl(n - 1);
+	unsigned long d = (n - 1) >> s, x;
+	for (int i = 0; i < base_count; ++i) {
+		if (*(base + i) % n == 0)
+			continue;
+		x = powmod(*(base + i), d, n);
+		if (x == 1 || x == n - 1)
+			continue;
+		int r = 1;
+		for (; r < s; ++r) {
+			x = mulmod(x, x, n);
+			if (x == n - 1)
+				break;
+		}
+		if (r == s)
+			return false;
+	}
+	return true;
+}
+
+unsigned long rho(unsigned long n) // a nontrivial factor of odd composite n
+{
+	unsigned long x, y, ys = 0, q, g;
+	for (unsigned long c = 1;; ++c) {
+		y = c + 1;
+		q = 1;
+		g = 1;
+		for (long r = 1; g == 1; r *= 2) {
+			x = y;
+			for (long i = 0; i < r; ++i)
+				y = rho_step(y, c, n);
+			for (long k = 0; k < r && g == 1; k += RHO_BATCH) {
+				ys = y;
+				for (long i = 0; i < RHO_BATCH && i < r - k; ++i) {
+					y = rho_step(y, c, n);
+					q = mulmod(q, x > y ? x - y : y - x, n);
+				}
+				g = gcd(q, n);
 			}
-			++count;
 		}
-		if (i == 2)
-			--i;
+		if (g == n) {
+			do {
+				ys = rho_step(ys, c, n);
+				g = gcd(x > ys ? x - ys : ys - x, n);
+			} while (g == 1);
+		}
+		if (g != n)
+			return g;
 	}
 }
 
-int main(int argc, char** argv)
+void add_factor(struct factor* factors, int* count, struct bignum p, int exp)
 {
-	if (argc == 1) {
-		printf("Monzocalc: a CLI tool for calculating interval monzos\n");
-		printf("by Tristan Bay\n");
+	(factors + *count)->p = p;
+	(factors + *count)->exp = exp;
+	++*count;
+}
+
+// adds the prime factors of x to factors, with sign as the power
+void factor(unsigned long x, int sign, struct factor* factors, int* count)
+{
+	// small primes first, since they're the most likely and rho is slow on them
+	for (; x >= SPF_LIMIT && !(x & 1); x >>= 1)
+		add_factor(factors, count, big_from(2), sign);
+	for (int i = 1; i < SMALL_PRIMES && x >= SPF_LIMIT; ++i) {
+		while (x * small_inverse[i] <= small_limit[i]) {
+			x *= small_inverse[i];
+			add_factor(factors, count, big_from(*(primes + i)), sign);
+		}
 	}
-	if (argc != 2) {
-		printf("Format: monzocalc numerator/denominator\n");
-		return 1;
+	if (x < SPF_LIMIT) {
+		while (x > 1) {
+			add_factor(factors, count, big_from(*(spf + x)), sign);
+			x /= *(spf + x);
+		}
+	} else if (is_prime(x)) {
+		add_factor(factors, count, big_from(x), sign);
+	} else {
+		unsigned long f = rho(x);
+		factor(f, sign, factors, count);
+		factor(x / f, sign, factors, count);
+	}
+}
+
+void factor_big(struct bignum x, int sign, struct factor* factors, int* count)
+{
+	for (int i = 0; i < BIG_TRIAL && big_len(&x) > 1; ++i) {
+		unsigned long p = *(primes + i);
+		struct bignum q = x;
+		while (big_div_small(&q, p) == 0) {
+			x = q;
+			add_factor(factors, count, big_from(p), sign);
+		}
+	}
+	if (big_len(&x) <= 1) {
+		factor(x.w[0], sign, factors, count);
+	} else if (big_is_prime(&x)) {
+		add_factor(factors, count, x, sign);
+	} else {
+		struct bignum f = big_rho(&x);
+		if (!big_len(&f)) {
+			char digits[20 * BIG_LIMBS];
+			big_to_string(x, digits);
+			fprintf(stderr, "Couldn't split %s, listed as a prime\n", digits);
+			add_factor(factors, count, x, sign);
+			return;
+		}
+		factor_big(f, sign, factors, count);
+		factor_big(big_div(&x, &f), sign, factors, count);
+	}
+}
+
+int compare_factors(const void* a, const void* b)
+{
+	return big_cmp(&((const struct factor*)a)->p, &((const struct factor*)b)->p);
+}
+
+// sorts the primes and adds up the powers of repeats, dropping any that cancel
+int calc_monzo(struct factor* factors, struct bignum n, struct bignum d)
+{
+	int count = 0, merged = 0;
+	if (big_len(&n) <= 1 && big_len(&d) <= 1) {
+		simplify(&n.w[0], &d.w[0]);
+		factor(n.w[0], 1, factors, &count);
+		factor(d.w[0], -1, factors, &count);
+	} else {
+		factor_big(n, 1, factors, &count);
+		factor_big(d, -1, factors, &count);
+	}
+	qsort(factors, count, sizeof(struct factor), compare_factors);
+	for (int i = 0; i < count; ++i) {
+		if (merged && !big_cmp(&(factors + merged - 1)->p, &(factors + i)->p))
+			(factors + merged - 1)->exp += (factors + i)->exp;
+		else
+			*(factors + merged++) = *(factors + i);
+		if (!(factors + merged - 1)->exp)
+			--merged;
 	}
-	int n, d;
-	sscanf(*(argv + 1), "%d/%d", &n, &d);
-	simplify(&n, &d);
-	int f_count = count_factors(n, d);
-	int factors[f_count], exponents[f_count];
-	calc_monzo(factors, exponents, f_count, n, d);
-	printf("[");
+	return merged;
+}
+
+void flush_out(struct out_buffer* out)
+{
+	fwrite(out->data, 1, out->len, out->f);
+	out->len = 0;
+}
+
+void put_str(struct out_buffer* out, const char* s)
+{
+	while (*s) {
+		if (out->len >= OUT_BUFFER)
+			flush_out(out);
+		out->data[out->len++] = *s++;
+	}
+}
+
+void put_num(struct out_buffer* out, long x)
+{
+	char digits[24];
+	int len = 0;
+	unsigned long u = x < 0 ? -(unsigned long)x : (unsigned long)x;
+	do {
+		digits[len++] = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (x < 0)
+		out->data[out->len++] = '-';
+	while (len)
+		out->data[out->len++] = digits[--len];
+}
+
+void put_monzo(struct out_buffer* out, struct bignum n, struct bignum d)
+{
+	static struct factor factors[2 * MAX_FACTORS];
+	char prime[20 * BIG_LIMBS];
+	int f_count = calc_monzo(factors, n, d);
+	put_str(out, "[");
 	for (int i = 0; i < f_count; ++i) {
-		printf("%d", *(exponents + i));
+		put_num(out, (factors + i)->exp);
 		if (i != f_count - 1)
-			printf(" ");
+			put_str(out, " ");
 	}
-	printf("> (");
+	put_str(out, "> (");
 	for (int i = 0; i < f_count; ++i) {
-		printf("%d", *(factors + i));
+		big_to_string((factors + i)->p, prime);
+		put_str(out, prime);
 		if (i != f_count - 1)
-			printf(".");
+			put_str(out, ".");
+	}
+	put_str(out, ")\n");
+	if (out->len > OUT_BUFFER)
+		flush_out(out);
+}
+
+// a/b or a on its own, both positive, false for anything else
+_Bool parse_ratio(const char* token, struct bignum* n, struct bignum* d)
+{
+	const char* end;
+	*d = big_from(1);
+	if (!big_parse(token, &end, n))
+		return false;
+	if (*end == '/' && !big_parse(end + 1, &end, d))
+		return false;
+	return !*end && big_len(n) && big_len(d);
+}
+
+void put_ratio(struct out_buffer* out, const char* token)
+{
+	struct bignum n, d;
+	if (!parse_ratio(token, &n, &d)) {
+		put_str(out, "Invalid ratio: ");
+		put_str(out, token);
+		put_str(out, "\n");
+		return;
+	}
+	put_monzo(out, n, d);
+}
+
+// divides p out of x as many times as it goes, returning how many
+int remove_prime(struct bignum* x, unsigned long p)
+{
+	int e = 0;
+	struct bignum q;
+	while (big_len(x) > 1) {
+		q = *x;
+		if (big_div_small(&q, p))
+			return e;
+		*x = q;
+		++e;
+	}
+	for (; x->w[0] % p == 0; ++e)
+		x->w[0] /= p;
+	return e;
+}
+
+// exponents of n/d over the subgroup, false if anything else is left over
+_Bool dense_monzo(struct bignum n, struct bignum d, short* exps)
+{
+	for (int i = 0; i < subgroup_size; ++i)
+		*(exps + i) = remove_prime(&n, subgroup[i])
+			- remove_prime(&d, subgroup[i]);
+	return big_is_small(&n, 1) && big_is_small(&d, 1);
+}
+
+void add_dense_row(short* exps, unsigned char flags)
+{
+	if (dense->count == dense->size) {
+		dense->size = dense->size ? 2 * dense->size : 4096;
+		dense->exps = realloc(dense->exps,
+			dense->size * subgroup_size * sizeof(short));
+		dense->flags = realloc(dense->flags, dense->size);
+	}
+	memcpy(dense->exps + dense->count * subgroup_size, exps,
+		subgroup_size * sizeof(short));
+	dense->flags[dense->count++] = flags;
+}
+
+void put_dense(struct out_buffer* out, const char* token)
+{
+	struct bignum n, d;
+	short exps[MAX_SUBGROUP] = { 0 };
+	unsigned char flags = 0;
+	if (!parse_ratio(token, &n, &d))
+		flags = DENSE_INVALID;
+	else if (!dense_monzo(n, d, exps))
+		flags = DENSE_OUTSIDE;
+	if (flags)
+		memset(exps, 0, sizeof(exps));
+	if (dense) {
+		add_dense_row(exps, flags);
+		return;
+	}
+	if (flags) {
+		put_str(out, flags == DENSE_INVALID ? "Invalid ratio: "
+			: "Outside subgroup: ");
+		put_str(out, token);
+		put_str(out, "\n");
+		return;
+	}
+	put_str(out, "[");
+	for (int i = 0; i < subgroup_size; ++i) {
+		if (out->len >= OUT_BUFFER)
+			flush_out(out);
+		put_num(out, exps[i]);
+		if (i != subgroup_size - 1)
+			put_str(out, " ");
+	}
+	put_str(out, ">\n");
+}
+
+unsigned long align_64(unsigned long x)
+{
+	return (x + 63) & ~63UL;
+}
+
+void pad_to(FILE* f, unsigned long offset)
+{
+	while ((unsigned long)ftell(f) < offset)
+		fputc(0, f);
+}
+
+int write_dense(const char* path)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	struct dense_header header = { DENSE_MAGIC, DENSE_VERSION, 1,
+		dense->count, subgroup_size, 0, 0, 0, 0, 0 };
+	for (unsigned long i = 0; i < dense->count * subgroup_size; ++i)
+		if (dense->exps[i] > 127 || dense->exps[i] < -128)
+			header.width = 2;
+	header.primes_offset = sizeof(header);
+	header.data_offset = align_64(header.primes_offset
+		+ subgroup_size * sizeof(uint64_t));
+	header.column_stride = align_64(dense->count * header.width);
+	header.flags_offset = header.data_offset
+		+ subgroup_size * header.column_stride;
+	fwrite(&header, sizeof(header), 1, f);
+	for (int j = 0; j < subgroup_size; ++j) {
+		uint64_t p = subgroup[j];
+		fwrite(&p, sizeof(p), 1, f);
+	}
+	signed char* column = malloc(header.column_stride);
+	for (int j = 0; j < subgroup_size; ++j) {
+		memset(column, 0, header.column_stride);
+		for (unsigned long i = 0; i < dense->count; ++i) {
+			int16_t e = dense->exps[i * subgroup_size + j];
+			if (header.width == 1)
+				column[i] = (signed char)e;
+			else
+				memcpy(column + 2 * i, &e, sizeof(e));
+		}
+		pad_to(f, header.data_offset + j * header.column_stride);
+		fwrite(column, 1, header.column_stride, f);
+	}
+	fwrite(dense->flags, 1, dense->count, f);
+	free(column);
+	if (fclose(f)) {
+		perror(path);
+		return 1;
 	}
-	printf(")\n");
 	return 0;
 }
+
+// reads "2.3.7" style subgroups or, with limit set, every prime up to it
+_Bool parse_subgroup(const char* s, _Bool limit)
+{
+	char* end;
+	if (limit) {
+		unsigned long l = strtoul(s, &end, 10);
+		if (*end || l < 2 || l >= SPF_LIMIT)
+			return false;
+		for (int i = 0; i < prime_count && *(primes + i) <= l; ++i) {
+			if (subgroup_size == MAX_SUBGROUP)
+				return false;
+			subgroup[subgroup_size++] = *(primes + i);
+		}
+		return true;
+	}
+	for (;;) {
+		unsigned long p = strtoul(s, &end, 10);
+		if (end == s || !is_prime(p) || subgroup_size == MAX_SUBGROUP
+				|| (subgroup_size && p <= subgroup[subgroup_size - 1]))
+			return false; // primes have to be listed in increasing order
+		subgroup[subgroup_size++] = p;
+		if (!*end)
+			return true;
+		if (*end != '.')
+			return false;
+		s = end + 1;
+	}
+}
+
+int stream_monzos(FILE* in)
+{
+	struct out_buffer out = { malloc(OUT_BUFFER + 4096), 0, stdout };
+	char* buffer = malloc(IN_BUFFER + 1);
+	size_t kept = 0, got;
+	_Bool skipping = 0; // the rest of a token too long to be a ratio
+	while ((got = fread(buffer + kept, 1, IN_BUFFER - kept, in)) > 0 || kept) {
+		size_t len = kept + got, start = 0, i;
+		_Bool last = got == 0;
+		for (; skipping && start < len; ++start)
+			if (buffer[start] == ' ' || buffer[start] == '\n'
+					|| buffer[start] == '\t' || buffer[start] == '\r')
+				skipping = 0;
+		for (i = start; i < len; ++i) {
+			if (buffer[i] != ' ' && buffer[i] != '\n' && buffer[i] != '\t'
+					&& buffer[i] != '\r')
+				continue;
+			if (i > start) { // a whole token
+				buffer[i] = '\0';
+				(subgroup_size ? put_dense : put_ratio)(&out, buffer + start);
+			}
+			start = i + 1;
+		}
+		if (last) { // the final token has no whitespace after it
+			if (len > start) {
+				buffer[len] = '\0';
+				(subgroup_size ? put_dense : put_ratio)(&out, buffer + start);
+			}
+			break;
+		}
+		kept = len - start;
+		if (kept >= IN_BUFFER / 2) { // nonsense too long to be a ratio
+			// reported by its start, and the rest of it skipped
+			strcpy(buffer + start + 32, "...");
+			(subgroup_size ? put_dense : put_ratio)(&out, buffer + start);
+			skipping = 1;
+			kept = 0;
+		}
+		memmove(buffer, buffer + start, kept);
+	}
+	flush_out(&out);
+	free(out.data);
+	free(buffer);
+	return 0;
+}
+
+int usage(void)
+{
+	printf("Format: monzocalc numerator/denominator\n");
+	printf("        monzocalc - (or -f file) for many ratios\n");
+	printf("Options: -l limit or -g 2.3.7 for dense rows over those primes,\n");
+	printf("         -b file to write the dense rows as a binary file\n");
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	const char* binary = NULL;
+	const char* input = NULL;
+	const char* ratio = NULL;
+	if (argc == 1) {
+		printf("Monzocalc: a CLI tool for calculating interval monzos\n");
+		printf("by Tristan Bay\n");
+	}
+	build_spf();
+	for (int i = 1; i < argc; ++i) {
+		if ((!strcmp(argv[i], "-l") || !strcmp(argv[i], "-g")) && i + 1 < argc
+				&& !subgroup_size) {
+			if (!parse_subgroup(argv[i + 1], argv[i][1] == 'l')) {
+				printf("Bad subgroup: %s\n", argv[i + 1]);
+				return 1;
+			}
+			++i;
+		} else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+			binary = argv[++i];
+		} else if (!strcmp(argv[i], "-f") && i + 1 < argc && !input && !ratio) {
+			input = argv[++i];
+		} else if (!input && !ratio) {
+			if (!strcmp(argv[i], "-"))
+				input = argv[i];
+			else
+				ratio = argv[i];
+		} else {
+			return usage();
+		}
+	}
+	if ((!input && !ratio) || (binary && !subgroup_size))
+		return usage();
+	if (binary)
+		dense = calloc(1, sizeof(struct dense_rows));
+	int status = 0;
+	if (input) {
+		FILE* in = strcmp(input, "-") ? fopen(input, "r") : stdin;
+		if (!in) {
+			perror(input);
+			return 1;
+		}
+		status = stream_monzos(in);
+		if (in != stdin)
+			fclose(in);
+	} else {
+		struct bignum n, d;
+		if (!strchr(ratio, '/') || !parse_ratio(ratio, &n, &d))
+			return usage();
+		struct out_buffer out = { malloc(OUT_BUFFER + 4096), 0, stdout };
+		if (subgroup_size)
+			put_dense(&out, ratio);
+		else
+			put_monzo(&out, n, d);
+		flush_out(&out);
+		free(out.data);
+	}
+	if (binary && !status)
+		status = write_dense(binary);
+	return status;
+}
@@ -1,13 +1,27 @@
 /* note-namer: A microtonal music tool by Tristan Bay
  * Provides a list of note names for a given equal division of the octave (EDO)
  * Ups and downs style notation, sometimes with half-accidentals
+ *
+ * With --range A B every EDO from A to B is named, each under an "Nedo" line
+ * and followed by a blank one. The names are written into a byte buffer
+ * rather than printed a glyph at a time; blocks of EDOs are handed out to -j
+ * threads (all cores unless it's given), each filling a buffer for its block,
+ * and those go out in order, one write a block.
+ *
+ * Compile with: cc -O2 -pthread note-namer.c -lm
  * Written Sep 2024 and Oct 2025, public domain code
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define TALLY 5 // constant for quips and quids
+#define EDO_BLOCK 16 // EDOs handed to a thread at a time
+#define BLOCK_WINDOW 8 // finished blocks per thread allowed to await writing
 
 typedef struct Note
 {
@@ -15,13 +29,50 @@ typedef struct Note
 	int flats, f_ups, f_nom; // flat note name
 } Note;
 
-void printnom(int nom)
+typedef struct Names // text on its way out
 {
-	char c = ((nom + 2) % 7) + 65; // capital C through G, then wraps to A and B
-	printf("%c", c);
+	char* text;
+	size_t length, room;
+} Names;
+
+struct block
+{
+	Names names; // of every EDO in the block
+	bool done;
+};
+
+struct sweep
+{
+	int first, last, block_count, next_block, written, window;
+	struct block* blocks; // ring buffer of window slots
+	pthread_mutex_t lock;
+	pthread_cond_t written_cond;
+};
+
+void put(Names* out, const char* text)
+{
+	size_t length = strlen(text);
+	if (out->length + length > out->room) {
+		out->room = (out->length + length) * 2 + 256;
+		out->text = realloc(out->text, out->room);
+	}
+	memcpy(out->text + out->length, text, length);
+	out->length += length;
+}
+
+void putrepeated(Names* out, const char* text, int count)
+{
+	for (int i = 0; i < count; ++i)
+		put(out, text);
+}
+
+void printnom(Names* out, int nom)
+{
+	char c[2] = { ((nom + 2) % 7) + 65, '\0' }; // capital C through G, then wraps to A and B
+	put(out, c);
 }
 
-void printupdown(int ups)
+void printupdown(Names* out, int ups)
 {
 	int quips = ups / 5;
 	int rem_ups = ups % 5;
@@ -29,88 +80,81 @@ void printupdown(int ups)
 		rem_ups /= -4;
 		quips = ups > 0 ? quips + 1 : quips - 1;
 	}
-	if (rem_ups < 0) {
-		for (int i = 0; i > rem_ups; --i)
-			printf("v");
-	} else {
-		for (int i = 0; i < rem_ups; ++i)
-			printf("^");
-	}
-	if (quips < 0) {
-		for (int i = 0; i > quips; --i)
-			printf("<");
-	} else {
-		for (int i = 0; i < quips; ++i)
-			printf(">");
-	}
+	if (rem_ups < 0)
+		putrepeated(out, "v", -rem_ups);
+	else
+		putrepeated(out, "^", rem_ups);
+	if (quips < 0)
+		putrepeated(out, "<", -quips);
+	else
+		putrepeated(out, ">", quips);
 }
 
-void printflat(int flats, bool half); // prototype for printsharp to reference
+void printflat(Names* out, int flats, bool half); // prototype for printsharp to reference
 
-void printsharp(int sharps, bool half)
+void printsharp(Names* out, int sharps, bool half)
 {
 	if (sharps < 0) {
-		printflat(sharps * -1, half);
+		printflat(out, sharps * -1, half);
 	} else {
 		if (half) {
 			if (sharps % 2 != 0) {
-				printf("‡");
+				put(out, "‡");
 				--sharps;
 			}
 			if (sharps % 4 != 0) {
-				printf("#");
+				put(out, "#");
 				sharps -= 2;
 			}
 			while (sharps > 0) {
-				printf("x");
+				put(out, "x");
 				sharps -= 4;
 			}
 		} else {
 			if (sharps % 2 != 0) {
-				printf("#");
+				put(out, "#");
 				--sharps;
 			}
 			while (sharps > 0) {
-				printf("x");
+				put(out, "x");
 				sharps -= 2;
 			}
 		}
 	}
 }
 
-void printflat(int flats, bool half)
+void printflat(Names* out, int flats, bool half)
 {
 	if (flats < 0) {
-		printsharp(flats * -1, half);
+		printsharp(out, flats * -1, half);
 	} else {
 		if (half) {
 			if (flats % 2 != 0) {
-				printf("d");
+				put(out, "d");
 				--flats;
 			}
 			for (int i = 0; i < flats; i += 2)
-				printf("b");
+				put(out, "b");
 		} else {
-			for (int i = 0; i < flats; ++i)
-				printf("b");
+			putrepeated(out, "b", flats);
 		}
 	}
 }
 
-void printnote(Note note, bool halves)
+void printnote(Names* out, Note note, bool halves)
 {
 	if (note.s_nom == note.f_nom) { // for natural notes, only print one name
-		printnom(note.s_nom);
+		printnom(out, note.s_nom);
 	} else {
-		printupdown(note.s_ups);
-		printnom(note.s_nom);
-		printsharp(note.sharps, halves);
-		printf(", ");
-		printupdown(note.f_ups);
-		printnom(note.f_nom);
-		printflat(note.flats, halves);
+		printupdown(out, note.s_ups);
+		printnom(out, note.s_nom);
+		printsharp(out, note.sharps, halves);
+		put(out, ", ");
+		printupdown(out, note.f_ups);
+		printnom(out, note.f_nom);
+		printflat(out, note.flats, halves);
 	}
-	printf("\n");
+	put(out, "\n");
 }
 
 int fifth(int edo)
@@ -267,14 +311,8 @@ void flatnotes(Note notes[], int edo, int p5, int p2, int ap, bool penta)
 	}
 }
 
-int main(int argc, char** argv)
+void nameedo(Names* out, int edo) // the note names of an EDO, in order
 {
-	if (argc != 2) {
-		printf("Usage: \"./note-namer [EDO]\"\n");
-		return 1;
-	}
-	int edo;
-	sscanf(argv[1], "%d", &edo);
 	int p5 = fifth(edo);
 	int p2 = majsec(edo, p5);
 	int a1 = apotome(edo, p5);
@@ -282,23 +320,118 @@ int main(int argc, char** argv)
 	bool halves = halfacc(a1);
 	if (halves) // use half of augmented unison instead of true a1 if possible
 		a1 /= 2;
-	Note notes[edo];
-	for (int i = 0; i < edo; ++i) {
-		notes[i].sharps = 0;
-		notes[i].s_ups = 0;
-		notes[i].s_nom = 0;
-		notes[i].flats = 0;
-		notes[i].f_ups = 0;
-		notes[i].f_nom = 0;
-	}
 	if (edo < 7 && edo != 5) {
-		printf("EDO is a subset of 12-equal or negative.\n");	
-	} else {
-		basicnotes(notes, edo, p5, p2, penta);
-		sharpnotes(notes, edo, p5, p2, a1, penta);
-		flatnotes(notes, edo, p5, p2, a1, penta);
-		for (int i = 0; i < edo; ++i)
-			printnote(notes[i], halves);
+		put(out, "EDO is a subset of 12-equal or negative.\n");
+		return;
 	}
+	Note* notes = calloc(edo, sizeof(Note));
+	basicnotes(notes, edo, p5, p2, penta);
+	sharpnotes(notes, edo, p5, p2, a1, penta);
+	flatnotes(notes, edo, p5, p2, a1, penta);
+	for (int i = 0; i < edo; ++i)
+		printnote(out, notes[i], halves);
+	free(notes);
+}
+
+void writeblocks(struct sweep* sw) // called with the lock held
+{
+	struct block* b = &sw->blocks[sw->written % sw->window];
+	while (sw->written < sw->block_count && b->done) {
+		fwrite(b->names.text, 1, b->names.length, stdout);
+		b->names.length = 0;
+		b->done = false;
+		++sw->written;
+		b = &sw->blocks[sw->written % sw->window];
+	}
+	pthread_cond_broadcast(&sw->written_cond);
+}
+
+void* sweepworker(void* arg)
+{
+	struct sweep* sw = arg;
+	Names names = { NULL, 0, 0 }, swap;
+	char heading[32];
+	pthread_mutex_lock(&sw->lock);
+	for (;;) {
+		while (sw->next_block < sw->block_count
+				&& sw->next_block >= sw->written + sw->window)
+			pthread_cond_wait(&sw->written_cond, &sw->lock);
+		if (sw->next_block >= sw->block_count)
+			break;
+		int index = sw->next_block++;
+		pthread_mutex_unlock(&sw->lock);
+		int first = sw->first + index * EDO_BLOCK;
+		names.length = 0;
+		for (int edo = first; edo < first + EDO_BLOCK && edo <= sw->last;
+				++edo) {
+			snprintf(heading, sizeof(heading), "%dedo\n", edo);
+			put(&names, heading);
+			nameedo(&names, edo);
+			put(&names, "\n");
+		}
+		pthread_mutex_lock(&sw->lock);
+		struct block* b = &sw->blocks[index % sw->window];
+		swap = b->names; // the slot's old buffer is reused next time
+		b->names = names;
+		names = swap;
+		b->done = true;
+		writeblocks(sw);
+	}
+	pthread_mutex_unlock(&sw->lock);
+	free(names.text);
+	return NULL;
+}
+
+int sweeprange(int first, int last, int threads)
+{
+	struct sweep sw = { 0 };
+	if (threads < 1)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+	sw.first = first;
+	sw.last = last;
+	sw.block_count = (last - first) / EDO_BLOCK + 1;
+	sw.window = threads * BLOCK_WINDOW;
+	sw.blocks = calloc(sw.window, sizeof(struct block));
+	pthread_mutex_init(&sw.lock, NULL);
+	pthread_cond_init(&sw.written_cond, NULL);
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, sweepworker, &sw);
+	for (int i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	for (int i = 0; i < sw.window; ++i)
+		free(sw.blocks[i].names.text);
+	free(sw.blocks);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "--range")) {
+		int first = 0, last = 0, threads = 0;
+		if ((argc == 4 || (argc == 6 && !strcmp(argv[4], "-j")))
+				&& sscanf(argv[2], "%d", &first) == 1
+				&& sscanf(argv[3], "%d", &last) == 1
+				&& (argc == 4 || sscanf(argv[5], "%d", &threads) == 1)
+				&& last >= first)
+			return sweeprange(first, last, threads);
+		printf("Usage: \"./note-namer --range [first EDO] [last EDO] "
+			"[-j threads]\"\n");
+		return 1;
+	}
+	if (argc != 2) {
+		printf("Usage: \"./note-namer [EDO]\"\n");
+		printf("       \"./note-namer --range [first EDO] [last EDO] "
+			"[-j threads]\"\n");
+		return 1;
+	}
+	int edo;
+	sscanf(argv[1], "%d", &edo);
+	Names names = { NULL, 0, 0 };
+	nameedo(&names, edo);
+	fwrite(names.text, 1, names.length, stdout);
+	free(names.text);
 	return 0;
 }
@@ -7,17 +7,154 @@ less. For example, 250/189 is in the 16-OPSL and above, but not the 15-OPSL or
 below, because 189 = 3 * 3 * 3 * 7, and 3 + 3 + 3 + 7 = 16, and because
 250 = 2 * 5 * 5 * 5, and 5 + 5 + 5 = 15.
 
+The numerators/denominators are generated without recursion: in one buffer
+sized from a count of them beforehand, then radix sorted. When there would be
+more than ARENA_LIMIT of them, or one doesn't fit in 64 bits, they're streamed
+in order from a heap of 128-bit numbers instead, each one giving rise to its
+multiple by its largest prime and to the number with that prime swapped for
+the next one, so the heap only ever grows by one at a time.
+
+The log2 of each numerator/denominator is worked out once into an aligned
+table. Each EDO then checks them a vector at a time (AVX2 or AVX-512 when the
+CPU has them), keeping only its sharpest and flattest error, and only the EDOs
+that stay within half a step go back over them to find which intervals those
+were. Blocks of EDOs are handed out to -j threads (all cores unless it's
+given) and printed in order. Streamed numerators/denominators aren't kept:
+they go by STREAM_SLICE at a time, each slice's logs thrown out by the same
+vector check for any EDO they put over half a step on their own, and the EDOs
+left carrying their sharpest and flattest error on into the next slice.
+
+With --max-opsl L MAXEDO it instead gives, for every EDO up to MAXEDO, the
+largest OPSL up to L it's consistent in. The sets for each OPSL contain the
+ones before, so the log2 table holds them one OPSL after another, each padded
+out to a whole vector with zeros, and an EDO goes through it until the first
+vector to put it over half a step; that vector's OPSL, less one, is the answer.
+That needs the whole table at once, so it stops at OPSLs with more than
+ARENA_LIMIT numerators/denominators.
+
+Without any arguments it asks for the OPSL and the EDO to search up to;
+./opslfinder OPSL MAXEDO takes them from the command line instead and leaves
+out the prompts.
+
+--build-index FILE L MAXEDO works out the same table as --max-opsl and writes
+it to FILE: the largest consistent OPSL of every EDO, then every EDO again
+grouped by that OPSL and in order within each group. --query FILE maps that in
+and answers "OPSL first-EDO last-EDO" lines from stdin, one line each, by
+binary searching each group that's consistent in the OPSL for the first EDO and
+merging the groups from there through a heap, so past the searches each EDO
+printed costs the log of the number of groups. The file's sections and group
+starts are checked before any query is answered.
+
+Compile with: cc -O2 -pthread opslfinder.c -lm
+
 Code by Tristan Bay | March and April 2023 | Public domain code
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define ARENA_LIMIT 16777216 // numerators/denominators sorted in memory
+#define LOG_ALIGN 8 // log2 table padded to a whole number of these
+#define EDO_BLOCK 4096 // EDOs handed to a thread at a time
+#define BLOCK_WINDOW 8 // finished blocks per thread allowed to await printing
+#define STREAM_SLICE 1048576 // streamed numerators/denominators held at once
+#define INDEX_VERSION 1
+#define U128_MAX (~(u128)0)
+
+typedef unsigned __int128 u128;
+
+struct harmonic_frame // still to be written out and multiplied on from
+{
+    u128 value;
+    unsigned long sum, index; // index of its largest prime
+    unsigned long factors; // how many primes, counting repeats
+};
+
+struct harmonic_entry
+{
+    u128 value;
+    unsigned long sum, index;
+};
+
+struct harmonic_stream // numerators/denominators in order, off a heap
+{
+    unsigned long upper, prime_count, size, room;
+    unsigned long* primes;
+    struct harmonic_entry* heap;
+    int started;
+};
+
+struct index_header // at the start of a --build-index file, 64 bytes
+{
+    char magic[8]; // "OPSLINDX"
+    uint32_t version, opsl_limit; // OPSLs past the limit aren't known
+    uint64_t max_edo;
+    uint64_t levels_offset; // a uint16_t for each EDO from 1
+    uint64_t group_offset; // opsl_limit + 2 uint64_t starts into the EDOs
+    uint64_t edos_offset; // uint32_t EDOs, grouped by largest OPSL
+    char padding[16];
+};
+
+struct harmonics
+{
+    unsigned long count;
+    unsigned long* values;
+    double* logs; // log2 of each, padded with zeros to LOG_ALIGN
+    double* check_logs; // the same, in the order EDOs are checked in
+};
 
-struct num_lll
+struct consistent
 {
-    unsigned long num;
-    struct num_lll* next;
+    unsigned long edo, sharpest, flattest; // indices into the harmonics
+    double error;
+};
+
+struct edo_block
+{
+    struct consistent* found;
+    unsigned long count, room;
+    unsigned long opsls[EDO_BLOCK]; // with --max-opsl
+    _Bool done;
+};
+
+struct stream_errors // the EDOs still consistent, as the stream goes by
+{
+    unsigned long active_count, slice_count, padded;
+    unsigned long* active; // EDOs still within half a step, in order
+    double* sharp_error, * flat_error; // indexed by EDO
+    u128* sharpest_harm, * flattest_harm;
+    u128* slice; // numerators/denominators waiting to be checked
+    double* slice_logs; // their log2, padded with zeros to LOG_ALIGN
+};
+
+struct slice_share // one thread's part of the active EDOs
+{
+    struct stream_errors* se;
+    unsigned long from, to, kept;
+};
+
+struct edo_sweep
+{
+    struct harmonics* harms;
+    unsigned long* chunk_opsls; // OPSL of each vector of logs, for --max-opsl
+    uint16_t* levels; // where --build-index has them go, not printed
+    unsigned long opsl_limit, padded;
+    unsigned long max_edo, block_count, next_block, printed, window;
+    struct edo_block* blocks; // ring buffer of window slots
+    pthread_mutex_t lock;
+    pthread_cond_t printed_cond;
 };
 
 unsigned long* odd_prime_list(unsigned long upper, unsigned long* amount)
@@ -26,149 +163,889 @@ unsigned long* odd_prime_list(unsigned long upper, unsigned long* amount)
         *amount = 0;
         return NULL;
     }
-    struct num_lll* head = calloc(1, sizeof(struct num_lll));
-    (*head).num = 3;
-    struct num_lll* check;
-    unsigned long counter = 5, qty = 1;
-    while (counter <= upper) {
-        check = head;
-        while (counter % (*check).num != 0) {
-            if (!(*check).next) {
-                (*check).next = calloc(1, sizeof(struct num_lll));
-                (*(*check).next).num = counter;
-                ++qty;
-            }
-            check = (*check).next;
-        }
-        counter += 2;
-    }
-    unsigned long* out = (unsigned long*)calloc(qty, sizeof(long));
-    struct num_lll* clean_up;
-    check = head;
-    for (unsigned long i = 0; i < qty; ++i) {
-        clean_up = check;
-        *(out + i) = (*check).num;
-        check = (*check).next;
-        free(clean_up);
+    // odd-only sieve, bit i standing for 2i + 3 and set once it's composite
+    unsigned long bits = (upper - 1) / 2, qty = 0;
+    unsigned char* composite = calloc(bits / 8 + 1, 1);
+    for (unsigned long i = 0; (2 * i + 3) * (2 * i + 3) <= upper; ++i) {
+        if (*(composite + i / 8) >> (i % 8) & 1)
+            continue;
+        for (unsigned long j = ((2 * i + 3) * (2 * i + 3) - 3) / 2; j < bits;
+                j += 2 * i + 3)
+            *(composite + j / 8) |= 1 << (j % 8);
     }
+    for (unsigned long i = 0; i < bits; ++i)
+        qty += !(*(composite + i / 8) >> (i % 8) & 1);
+    unsigned long* out = (unsigned long*)malloc(qty * sizeof(long));
+    qty = 0;
+    for (unsigned long i = 0; i < bits; ++i)
+        if (!(*(composite + i / 8) >> (i % 8) & 1))
+            *(out + qty++) = 2 * i + 3;
+    free(composite);
     *amount = qty;
     return out;
 }
 
-void add_to(struct num_lll** curr, unsigned long value)
+// how many numbers have each odd prime sum up to the limit, at most ULONG_MAX
+unsigned long* count_by_sum(unsigned long upper, unsigned long* primes,
+        unsigned long number_of_primes)
 {
-    (**curr).next = calloc(1, sizeof(struct num_lll));
-    *curr = (**curr).next;
-    (**curr).num = value;
+    unsigned long* ways = calloc(upper + 1, sizeof(long));
+    *ways = 1;
+    for (unsigned long i = 0; i < number_of_primes; ++i)
+        for (unsigned long j = *(primes + i); j <= upper; ++j)
+            *(ways + j) = *(ways + j) > ULONG_MAX - *(ways + j - *(primes + i))
+                ? ULONG_MAX : *(ways + j) + *(ways + j - *(primes + i));
+    return ways;
 }
 
-void num_search(unsigned long upper, unsigned long* primes,
-        unsigned long index, unsigned long* amount, unsigned long sum,
-        unsigned long product, struct num_lll** curr)
+// how many numbers there are at or below the limit, at most ULONG_MAX
+unsigned long count_at_or_below_limit(unsigned long upper,
+        unsigned long* primes, unsigned long number_of_primes)
 {
-    if (*(primes + index) + sum <= upper) {
-        add_to(curr, *(primes + index) * product);
-        ++(*amount);
-        num_search(upper, primes, index, amount, *(primes + index) + sum,
-            *(primes + index) * product, curr);
-    }
-    if (index > 0) {
-        num_search(upper, primes, index - 1, amount, sum, product, curr);
-    }
+    unsigned long* ways = count_by_sum(upper, primes, number_of_primes),
+        total = 0;
+    for (unsigned long j = 0; j <= upper; ++j)
+        total = total > ULONG_MAX - *(ways + j) ? ULONG_MAX : total + *(ways + j);
+    free(ways);
+    return total;
 }
 
-int compare(const void* x, const void* y)
+void radix_sort(unsigned long* values, unsigned long count)
 {
-    return *(unsigned long*)x - *(unsigned long*)y;
+    unsigned long* spare = malloc(count * sizeof(long)), * from = values,
+        * to = spare, * swap;
+    unsigned long* buckets = malloc(65536 * sizeof(long));
+    for (int shift = 0; shift < 64; shift += 16) {
+        memset(buckets, 0, 65536 * sizeof(long));
+        for (unsigned long i = 0; i < count; ++i)
+            ++*(buckets + (*(from + i) >> shift & 65535));
+        if (*(buckets + (*from >> shift & 65535)) == count)
+            continue; // all the same in these bits
+        for (unsigned long i = 0, start = 0, size; i < 65536; ++i) {
+            size = *(buckets + i);
+            *(buckets + i) = start;
+            start += size;
+        }
+        for (unsigned long i = 0; i < count; ++i)
+            *(to + (*(buckets + (*(from + i) >> shift & 65535)))++) = *(from + i);
+        swap = from; from = to; to = swap;
+    }
+    if (from != values)
+        memcpy(values, from, count * sizeof(long));
+    free(spare);
+    free(buckets);
 }
 
+// sorted, or NULL if there are too many or they don't fit in 64 bits
 unsigned long* at_or_below_limit(unsigned long upper, unsigned long* primes,
         unsigned long number_of_primes, unsigned long* amount)
 {
-    struct num_lll* head = calloc(1, sizeof(struct num_lll)),
-        * current = head;
-    unsigned long qty = 1;
-    (*head).num = 1;
-    num_search(upper, primes, number_of_primes - 1, &qty, 0, 1, &current);
-    unsigned long* out = (unsigned long*)calloc(qty, sizeof(long));
-    struct num_lll* clean_up;
-    current = head;
-    for (unsigned long i = 0; i < qty; ++i) {
-        clean_up = current;
-        *(out + i) = (*current).num;
-        current = (*current).next;
-        free(clean_up);
-    }
-    qsort(out, qty, sizeof(long), compare);
+    unsigned long qty = count_at_or_below_limit(upper, primes,
+        number_of_primes), depth = 0, room = 64;
     *amount = qty;
+    if (qty > ARENA_LIMIT)
+        return NULL;
+    unsigned long* out = (unsigned long*)malloc(qty * sizeof(long));
+    struct harmonic_frame* stack = malloc(room * sizeof(struct harmonic_frame));
+    struct harmonic_frame frame = { 1, 0, 0, 0 };
+    *stack = frame;
+    depth = 1;
+    qty = 0;
+    while (depth) {
+        frame = *(stack + --depth);
+        *(out + qty++) = (unsigned long)frame.value;
+        for (unsigned long i = frame.index; i < number_of_primes
+                && frame.sum + *(primes + i) <= upper; ++i) {
+            if (frame.value > ULONG_MAX / *(primes + i)) {
+                free(stack);
+                free(out);
+                return NULL;
+            }
+            if (depth == room)
+                stack = realloc(stack, (room *= 2)
+                    * sizeof(struct harmonic_frame));
+            (stack + depth)->value = frame.value * *(primes + i);
+            (stack + depth)->sum = frame.sum + *(primes + i);
+            (stack + depth++)->index = i;
+        }
+    }
+    free(stack);
+    radix_sort(out, qty);
     return out;
 }
 
-unsigned long max(unsigned long x, unsigned long y)
+void stream_push(struct harmonic_stream* st, u128 value, unsigned long sum,
+        unsigned long index)
+{
+    if (st->size == st->room)
+        st->heap = realloc(st->heap, (st->room = st->room ? st->room * 2 : 64)
+            * sizeof(struct harmonic_entry));
+    unsigned long i = st->size++, parent;
+    for (; i && (st->heap + (parent = (i - 1) / 2))->value > value; i = parent)
+        *(st->heap + i) = *(st->heap + parent);
+    (st->heap + i)->value = value;
+    (st->heap + i)->sum = sum;
+    (st->heap + i)->index = index;
+}
+
+// the next numerator/denominator, or 0 when they've all been through
+u128 next_harmonic(struct harmonic_stream* st)
+{
+    if (!st->started) {
+        st->started = 1;
+        if (st->prime_count && *st->primes <= st->upper)
+            stream_push(st, *st->primes, *st->primes, 0);
+        return 1;
+    }
+    if (!st->size)
+        return 0;
+    struct harmonic_entry top = *st->heap, last = *(st->heap + --st->size);
+    unsigned long i = 0, child;
+    while ((child = 2 * i + 1) < st->size) { // sift the last one down
+        if (child + 1 < st->size
+                && (st->heap + child + 1)->value < (st->heap + child)->value)
+            ++child;
+        if ((st->heap + child)->value >= last.value)
+            break;
+        *(st->heap + i) = *(st->heap + child);
+        i = child;
+    }
+    if (st->size)
+        *(st->heap + i) = last;
+    unsigned long p = *(st->primes + top.index), next;
+    if (top.sum + p <= st->upper) {
+        if (top.value > U128_MAX / p) {
+            fprintf(stderr, "OPSL too large: numbers pass 2^128\n");
+            exit(1);
+        }
+        stream_push(st, top.value * p, top.sum + p, top.index);
+    }
+    if (top.index + 1 < st->prime_count
+            && top.sum - p + (next = *(st->primes + top.index + 1)) <= st->upper) {
+        if (top.value / p > U128_MAX / next) {
+            fprintf(stderr, "OPSL too large: numbers pass 2^128\n");
+            exit(1);
+        }
+        stream_push(st, top.value / p * next, top.sum - p + next,
+            top.index + 1);
+    }
+    return top.value;
+}
+
+void print_u128(u128 x)
+{
+    char digits[40];
+    int i = 40;
+    digits[--i] = '\0';
+    do {
+        digits[--i] = '0' + (int)(x % 10);
+        x /= 10;
+    } while (x);
+    printf("%s", digits + i);
+}
+
+u128 max(u128 x, u128 y)
 {
 	if (x > y)
 		return x;
 	return y;
 }
 
-unsigned long min_adjusted(unsigned long x, unsigned long y)
+u128 min_adjusted(u128 x, u128 y)
 {
-	unsigned long hi, lo;
+	u128 hi, lo;
 	if (x > y) {
 		hi = x; lo = y;
 	} else {
 		hi = y; lo = x;
 	}
-	while (hi >= lo * 2)
+	while (hi / 2 >= lo) // lo * 2 could wrap
 		lo *= 2;
 	return lo;
 }
 
-void show_consistent_edos(unsigned long* harms, unsigned long harm_count,
-        unsigned long max_edo)
+// where the errors of the harmonics first spread over more than half a step
+// (somewhere in the vector of LOG_ALIGN logs it's in), count if they don't
+unsigned long edo_failure_portable(const double* logs, unsigned long count,
+        double edo)
+{
+    double sharp_error = 0, flat_error = 0, harm_error;
+    for (unsigned long j = 0; j < count; ++j) {
+        harm_error = logs[j] * edo;
+        harm_error -= floor(harm_error);
+        if (harm_error < 0.5) {
+            if (harm_error > sharp_error)
+                sharp_error = harm_error;
+        } else if (1 - harm_error > flat_error) {
+            flat_error = 1 - harm_error;
+        }
+        if (sharp_error + flat_error > 0.5)
+            return j;
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+unsigned long edo_failure_avx2(const double* logs, unsigned long count,
+        double edo)
+{
+    __m256d e = _mm256_set1_pd(edo), half = _mm256_set1_pd(0.5),
+        one = _mm256_set1_pd(1.0), sharp = _mm256_setzero_pd(),
+        flat = _mm256_setzero_pd(), x, below;
+    double lanes[4];
+    for (unsigned long j = 0; j < count; j += LOG_ALIGN) {
+        for (int k = 0; k < LOG_ALIGN; k += 4) {
+            x = _mm256_mul_pd(_mm256_load_pd(logs + j + k), e);
+            x = _mm256_sub_pd(x, _mm256_floor_pd(x));
+            below = _mm256_cmp_pd(x, half, _CMP_LT_OQ);
+            sharp = _mm256_max_pd(sharp, _mm256_and_pd(below, x));
+            flat = _mm256_max_pd(flat,
+                _mm256_andnot_pd(below, _mm256_sub_pd(one, x)));
+        }
+        _mm256_storeu_pd(lanes, sharp);
+        double sharp_error = fmax(fmax(lanes[0], lanes[1]),
+            fmax(lanes[2], lanes[3]));
+        _mm256_storeu_pd(lanes, flat);
+        if (sharp_error + fmax(fmax(lanes[0], lanes[1]),
+                fmax(lanes[2], lanes[3])) > 0.5)
+            return j;
+    }
+    return count;
+}
+
+__attribute__((target("avx512f")))
+unsigned long edo_failure_avx512(const double* logs, unsigned long count,
+        double edo)
+{
+    __m512d e = _mm512_set1_pd(edo), one = _mm512_set1_pd(1.0),
+        sharp = _mm512_setzero_pd(), flat = _mm512_setzero_pd(), x;
+    __mmask8 below;
+    for (unsigned long j = 0; j < count; j += LOG_ALIGN) {
+        x = _mm512_mul_pd(_mm512_load_pd(logs + j), e);
+        x = _mm512_sub_pd(x, _mm512_roundscale_pd(x, _MM_FROUND_TO_NEG_INF));
+        below = _mm512_cmp_pd_mask(x, _mm512_set1_pd(0.5), _CMP_LT_OQ);
+        sharp = _mm512_mask_max_pd(sharp, below, sharp, x);
+        flat = _mm512_mask_max_pd(flat, ~below, flat, _mm512_sub_pd(one, x));
+        if (_mm512_reduce_max_pd(sharp) + _mm512_reduce_max_pd(flat) > 0.5)
+            return j;
+    }
+    return count;
+}
+#endif
+
+unsigned long (*edo_failure)(const double*, unsigned long, double)
+    = edo_failure_portable;
+
+void pick_kernel(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f"))
+        edo_failure = edo_failure_avx512;
+    else if (__builtin_cpu_supports("avx2"))
+        edo_failure = edo_failure_avx2;
+#endif
+}
+
+// the errors of an EDO that's consistent, worked out the way they always
+// were so the intervals named are the first of the sharpest and flattest
+void find_errors(struct harmonics* harms, unsigned long edo,
+        struct consistent* c)
+{
+    double sharp_error = 0, flat_error = 0, harm_error, extra;
+    c->edo = edo;
+    c->sharpest = 0; c->flattest = 0; // the 1 at the front
+    for (unsigned long j = 1; j < harms->count; ++j) {
+        harm_error = modf(*(harms->logs + j) * edo, &extra);
+        if (harm_error < 0.5) {
+            if (harm_error > sharp_error) {
+                sharp_error = harm_error;
+                c->sharpest = j;
+            }
+        } else {
+            if (1 - harm_error > flat_error) {
+                flat_error = 1 - harm_error;
+                c->flattest = j;
+            }
+        }
+    }
+    c->error = sharp_error + flat_error;
+}
+
+void print_blocks(struct edo_sweep* sw) // called with the lock held
+{
+    struct edo_block* b = sw->blocks + sw->printed % sw->window;
+    while (sw->printed < sw->block_count && b->done) {
+        for (unsigned long i = 0; sw->chunk_opsls && i < EDO_BLOCK
+                && sw->printed * EDO_BLOCK + i < sw->max_edo; ++i) {
+            if (sw->levels)
+                *(sw->levels + sw->printed * EDO_BLOCK + i)
+                    = (uint16_t)b->opsls[i];
+            else
+                printf("%luedo\t%lu%s\n", sw->printed * EDO_BLOCK + i + 1,
+                    b->opsls[i], b->opsls[i] == sw->opsl_limit ? "+" : "");
+        }
+        for (unsigned long i = 0; i < b->count; ++i) {
+            struct consistent* c = b->found + i;
+            u128 sharpest = *(sw->harms->values + c->sharpest),
+                flattest = *(sw->harms->values + c->flattest);
+            printf("%luedo\t%lf%% max error (at interval ", c->edo,
+                c->error * 100);
+            print_u128(max(sharpest, flattest));
+            printf("/");
+            print_u128(min_adjusted(sharpest, flattest));
+            printf(")\n");
+        }
+        b->count = 0;
+        b->done = 0;
+        ++sw->printed;
+        b = sw->blocks + sw->printed % sw->window;
+    }
+    pthread_cond_broadcast(&sw->printed_cond);
+}
+
+void* edo_worker(void* arg)
+{
+    struct edo_sweep* sw = arg;
+    struct harmonics* harms = sw->harms;
+    unsigned long found_count, found_room = 16, opsls[EDO_BLOCK], failure;
+    struct consistent* found = malloc(found_room * sizeof(struct consistent));
+    pthread_mutex_lock(&sw->lock);
+    for (;;) {
+        while (sw->next_block < sw->block_count
+                && sw->next_block >= sw->printed + sw->window)
+            pthread_cond_wait(&sw->printed_cond, &sw->lock);
+        if (sw->next_block >= sw->block_count)
+            break;
+        unsigned long index = sw->next_block++;
+        pthread_mutex_unlock(&sw->lock);
+        unsigned long first = index * EDO_BLOCK + 1;
+        found_count = 0;
+        for (unsigned long i = first;
+                i < first + EDO_BLOCK && i <= sw->max_edo; ++i) {
+            failure = edo_failure(harms->check_logs, sw->padded, (double)i);
+            if (sw->chunk_opsls) { // the OPSL it failed at is one too many
+                opsls[i - first] = failure == sw->padded ? sw->opsl_limit
+                    : *(sw->chunk_opsls + failure / LOG_ALIGN) - 1;
+                continue;
+            }
+            if (failure < sw->padded)
+                continue;
+            if (found_count == found_room)
+                found = realloc(found, (found_room *= 2)
+                    * sizeof(struct consistent));
+            find_errors(harms, i, found + found_count++);
+        }
+        pthread_mutex_lock(&sw->lock);
+        struct edo_block* b = sw->blocks + index % sw->window;
+        if (b->room < found_count) {
+            b->room = found_count;
+            b->found = realloc(b->found, b->room * sizeof(struct consistent));
+        }
+        memcpy(b->found, found, found_count * sizeof(struct consistent));
+        memcpy(b->opsls, opsls, sizeof(opsls));
+        b->count = found_count;
+        b->done = 1;
+        print_blocks(sw);
+    }
+    pthread_mutex_unlock(&sw->lock);
+    free(found);
+    return NULL;
+}
+
+// padded is filled in already, and chunk_opsls and opsl_limit for --max-opsl
+void show_consistent_edos(struct edo_sweep sw, struct harmonics* harms,
+        unsigned long max_edo, int threads)
+{
+    if (threads < 1)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1)
+        threads = 1;
+    pick_kernel();
+    sw.harms = harms;
+    sw.max_edo = max_edo;
+    sw.block_count = (max_edo + EDO_BLOCK - 1) / EDO_BLOCK;
+    sw.window = threads * BLOCK_WINDOW;
+    sw.blocks = calloc(sw.window, sizeof(struct edo_block));
+    pthread_mutex_init(&sw.lock, NULL);
+    pthread_cond_init(&sw.printed_cond, NULL);
+    pthread_t workers[threads];
+    for (int i = 0; i < threads; ++i)
+        pthread_create(&workers[i], NULL, edo_worker, &sw);
+    for (int i = 0; i < threads; ++i)
+        pthread_join(workers[i], NULL);
+    for (unsigned long i = 0; i < sw.window; ++i)
+        free((sw.blocks + i)->found);
+    free(sw.blocks);
+}
+
+// the log2 table, worked out as log(h) / log(2) has always been
+void build_logs(struct harmonics* harms)
+{
+    unsigned long padded = (harms->count + LOG_ALIGN - 1) / LOG_ALIGN
+        * LOG_ALIGN;
+    harms->logs = aligned_alloc(64, (padded * sizeof(double) + 63) / 64 * 64);
+    for (unsigned long j = 0; j < padded; ++j)
+        *(harms->logs + j) = j < harms->count
+            ? log((double)*(harms->values + j)) / log(2) : 0;
+}
+
+void errors_init(struct stream_errors* se, unsigned long max_edo)
 {
-    double sharp_error, flat_error, harm_error, extra;
-	unsigned long sharpest_harm, flattest_harm;
+    se->active_count = max_edo;
+    se->slice_count = 0;
+    se->active = malloc((max_edo + 1) * sizeof(long));
+    se->sharp_error = calloc(max_edo + 1, sizeof(double));
+    se->flat_error = calloc(max_edo + 1, sizeof(double));
+    se->sharpest_harm = malloc((max_edo + 1) * sizeof(u128));
+    se->flattest_harm = malloc((max_edo + 1) * sizeof(u128));
+    se->slice = malloc(STREAM_SLICE * sizeof(u128));
+    se->slice_logs = aligned_alloc(64, STREAM_SLICE * sizeof(double));
     for (unsigned long i = 1; i <= max_edo; ++i) {
-        sharp_error = 0; flat_error = 0;
-		sharpest_harm = 1; flattest_harm = 1;
-        for (unsigned long j = 1;
-                j < harm_count && sharp_error + flat_error <= 0.5; ++j) {
-            harm_error = modf(log(*(harms + j)) / log(2) * i, &extra);
+        *(se->active + i - 1) = i;
+        *(se->sharpest_harm + i) = 1;
+        *(se->flattest_harm + i) = 1;
+    }
+}
+
+// checks a share of the active EDOs against the slice, keeping the ones
+// still consistent at the front of the share
+void* slice_worker(void* arg)
+{
+    struct slice_share* share = arg;
+    struct stream_errors* se = share->se;
+    double harm_error, extra;
+    unsigned long i;
+    share->kept = share->from;
+    for (unsigned long j = share->from; j < share->to; ++j) {
+        i = *(se->active + j);
+        // over half a step on the slice alone is over it on the whole set
+        if (edo_failure(se->slice_logs, se->padded, (double)i) < se->padded)
+            continue;
+        for (unsigned long k = 0; k < se->slice_count; ++k) {
+            harm_error = modf(*(se->slice_logs + k) * i, &extra);
             if (harm_error < 0.5) {
-                if (harm_error > sharp_error) {
-                    sharp_error = harm_error;
-					sharpest_harm = *(harms + j);
-                }
-            } else {
-                if (1 - harm_error > flat_error) {
-                    flat_error = 1 - harm_error;
-					flattest_harm = *(harms + j);
+                if (harm_error > *(se->sharp_error + i)) {
+                    *(se->sharp_error + i) = harm_error;
+                    *(se->sharpest_harm + i) = *(se->slice + k);
                 }
+            } else if (1 - harm_error > *(se->flat_error + i)) {
+                *(se->flat_error + i) = 1 - harm_error;
+                *(se->flattest_harm + i) = *(se->slice + k);
             }
         }
-        if (sharp_error + flat_error <= 0.5) {
-            printf("%luedo\t%lf%% max error (at interval %lu/%lu)\n",
-                i, (sharp_error + flat_error) * 100,
-				max(sharpest_harm, flattest_harm),
-				min_adjusted(sharpest_harm, flattest_harm));
+        if (*(se->sharp_error + i) + *(se->flat_error + i) <= 0.5)
+            *(se->active + share->kept++) = i;
+    }
+    return NULL;
+}
+
+// checks the EDOs still active against the numerators/denominators in the
+// slice, then empties it
+void errors_check_slice(struct stream_errors* se, int threads)
+{
+    se->padded = (se->slice_count + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN;
+    for (unsigned long k = 0; k < se->padded; ++k)
+        *(se->slice_logs + k) = k < se->slice_count
+            ? log((double)*(se->slice + k)) / log(2) : 0;
+    if ((unsigned long)threads > se->active_count / 64 + 1)
+        threads = (int)(se->active_count / 64 + 1);
+    struct slice_share shares[threads];
+    pthread_t workers[threads];
+    for (int t = 0; t < threads; ++t) {
+        shares[t].se = se;
+        shares[t].from = se->active_count * t / threads;
+        shares[t].to = se->active_count * (t + 1) / threads;
+        pthread_create(&workers[t], NULL, slice_worker, &shares[t]);
+    }
+    se->active_count = 0;
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(workers[t], NULL);
+        memmove(se->active + se->active_count, se->active + shares[t].from,
+            (shares[t].kept - shares[t].from) * sizeof(long));
+        se->active_count += shares[t].kept - shares[t].from;
+    }
+    se->slice_count = 0;
+}
+
+// takes in one more numerator/denominator, checking a slice once it's full
+void errors_add(struct stream_errors* se, u128 harm, int threads)
+{
+    *(se->slice + se->slice_count++) = harm;
+    if (se->slice_count == STREAM_SLICE)
+        errors_check_slice(se, threads);
+}
+
+void show_streamed_edos(struct stream_errors* se, int threads)
+{
+    if (se->slice_count)
+        errors_check_slice(se, threads);
+    for (unsigned long j = 0; j < se->active_count; ++j) {
+        unsigned long i = *(se->active + j);
+        printf("%luedo\t%lf%% max error (at interval ", i,
+            (*(se->sharp_error + i) + *(se->flat_error + i)) * 100);
+        print_u128(max(*(se->sharpest_harm + i), *(se->flattest_harm + i)));
+        printf("/");
+        print_u128(min_adjusted(*(se->sharpest_harm + i),
+            *(se->flattest_harm + i)));
+        printf(")\n");
+    }
+    free(se->active);
+    free(se->sharp_error);
+    free(se->flat_error);
+    free(se->sharpest_harm);
+    free(se->flattest_harm);
+    free(se->slice);
+    free(se->slice_logs);
+}
+
+// the log2 table EDOs are checked against. The primes go first, as they're
+// cheap to check and in every set; then the rest with the most prime factors
+// first, since a harmonic's error can be up to half a step for each, so
+// those throw out a bad EDO soonest; and 1 last. With chunk_opsls (for
+// --max-opsl) that goes for each odd prime sum in turn, each padded out to
+// LOG_ALIGN, with the sum of each vector written to chunk_opsls. Gives 0
+// if there are more than ARENA_LIMIT of them or there isn't the memory.
+unsigned long build_check_logs(unsigned long upper, unsigned long* primes,
+        unsigned long number_of_primes, struct harmonics* harms,
+        unsigned long** chunk_opsls)
+{
+    if (chunk_opsls)
+        *chunk_opsls = NULL;
+    // this also keeps upper small enough for the table below, which goes
+    // up with its square
+    if (count_at_or_below_limit(upper, primes, number_of_primes)
+            > ARENA_LIMIT)
+        return 0;
+    unsigned long most = upper / 3 + 1, sums = chunk_opsls ? upper + 1 : 1,
+        groups = sums * (most + 1), padded = 0;
+    // numbers by odd prime sum and how many factors, as in count_by_sum
+    unsigned long* ways = calloc((upper + 1) * (most + 1), sizeof(long));
+    unsigned long* next = malloc(groups * sizeof(long)), * count;
+    if (!ways || !next) {
+        free(ways);
+        free(next);
+        return 0;
+    }
+    *ways = 1;
+    for (unsigned long i = 0; i < number_of_primes; ++i)
+        for (unsigned long j = *(primes + i); j <= upper; ++j)
+            for (unsigned long f = 1; f <= most; ++f) {
+                count = ways + j * (most + 1) + f;
+                *count = *count > ULONG_MAX
+                    - *(ways + (j - *(primes + i)) * (most + 1) + f - 1)
+                    ? ULONG_MAX
+                    : *count + *(ways + (j - *(primes + i)) * (most + 1) + f - 1);
+            }
+    // group g of a sum holds the numbers with 1, most, most - 1 ... 2, 0
+    // factors in that order
+    memset(next, 0, groups * sizeof(long));
+    for (unsigned long j = 0; j <= upper; ++j)
+        for (unsigned long f = 0; f <= most; ++f)
+            *(next + (chunk_opsls ? j : 0) * (most + 1)
+                + (f == 1 ? 0 : f ? most + 1 - f : most))
+                += *(ways + j * (most + 1) + f);
+    for (unsigned long g = 0, size; g < groups; ++g) {
+        size = *(next + g);
+        *(next + g) = padded;
+        padded += size;
+        if (!chunk_opsls || g % (most + 1) < most)
+            continue;
+        padded = (padded + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN;
+        *chunk_opsls = realloc(*chunk_opsls, padded / LOG_ALIGN * sizeof(long));
+        for (unsigned long i = *(next + g - most) / LOG_ALIGN;
+                i < padded / LOG_ALIGN; ++i)
+            *(*chunk_opsls + i) = g / (most + 1);
+    }
+    padded = (padded + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN;
+    harms->check_logs = aligned_alloc(64,
+        (padded * sizeof(double) + 63) / 64 * 64);
+    if (!harms->check_logs) {
+        free(ways);
+        free(next);
+        return 0;
+    }
+    memset(harms->check_logs, 0, padded * sizeof(double));
+    unsigned long depth = 1, room = 64;
+    struct harmonic_frame* stack = malloc(room * sizeof(struct harmonic_frame));
+    struct harmonic_frame frame = { 1, 0, 0, 0 };
+    *stack = frame;
+    while (depth) {
+        frame = *(stack + --depth);
+        *(harms->check_logs + (*(next + (chunk_opsls ? frame.sum : 0)
+            * (most + 1) + (frame.factors == 1 ? 0 : frame.factors
+            ? most + 1 - frame.factors : most)))++)
+            = log((double)frame.value) / log(2);
+        for (unsigned long i = frame.index; i < number_of_primes
+                && frame.sum + *(primes + i) <= upper; ++i) {
+            if (frame.value > U128_MAX / *(primes + i)) {
+                fprintf(stderr, "OPSL too large: numbers pass 2^128\n");
+                exit(1);
+            }
+            if (depth == room)
+                stack = realloc(stack, (room *= 2)
+                    * sizeof(struct harmonic_frame));
+            (stack + depth)->value = frame.value * *(primes + i);
+            (stack + depth)->sum = frame.sum + *(primes + i);
+            (stack + depth)->factors = frame.factors + 1;
+            (stack + depth++)->index = i;
         }
     }
+    free(stack);
+    free(ways);
+    free(next);
+    return padded;
 }
 
-int main()
+int max_opsl_table(unsigned long limit, unsigned long max_edo, int threads)
 {
-    unsigned long limit, prime_count, use_in_fractions_count; 
-    unsigned long* primes, * use_in_fractions;
-    unsigned long max_edo;
-    printf("OPSL to use: ");
-    scanf("%lu", &limit);
-    fflush(stdin);
-    printf("\nSearch up to EDO: ");
-    scanf("%lu", &max_edo);
-    fflush(stdin);
+    unsigned long prime_count;
+    unsigned long* primes = odd_prime_list(limit, &prime_count);
+    struct harmonics harms = { 0 };
+    struct edo_sweep sw = { 0 };
+    sw.opsl_limit = limit;
+    sw.padded = build_check_logs(limit, primes, prime_count, &harms,
+        &sw.chunk_opsls);
+    if (!sw.padded) {
+        fprintf(stderr, "OPSL %lu has more than %d numerators/denominators "
+            "to keep\n", limit, ARENA_LIMIT);
+        free(primes);
+        free(sw.chunk_opsls);
+        return 1;
+    }
+    printf("EDO\tlargest consistent OPSL (+ if it goes further)\n");
+    show_consistent_edos(sw, &harms, max_edo, threads);
+    free(primes);
+    free(harms.check_logs);
+    free(sw.chunk_opsls);
+    return 0;
+}
+
+int build_index(const char* file, unsigned long limit, unsigned long max_edo,
+        int threads)
+{
+    if (limit > UINT16_MAX || max_edo > UINT32_MAX) {
+        printf("The index goes up to OPSL %d and EDO %lu\n", UINT16_MAX,
+            (unsigned long)UINT32_MAX);
+        return 1;
+    }
+    unsigned long prime_count;
+    unsigned long* primes = odd_prime_list(limit, &prime_count);
+    struct harmonics harms = { 0 };
+    struct edo_sweep sw = { 0 };
+    sw.opsl_limit = limit;
+    sw.padded = build_check_logs(limit, primes, prime_count, &harms,
+        &sw.chunk_opsls);
+    if (!sw.padded) {
+        fprintf(stderr, "OPSL %lu has more than %d numerators/denominators "
+            "to keep\n", limit, ARENA_LIMIT);
+        free(primes);
+        free(sw.chunk_opsls);
+        return 1;
+    }
+    sw.levels = malloc((max_edo + 1) * sizeof(uint16_t));
+    uint64_t* group = calloc(limit + 2, sizeof(uint64_t));
+    uint32_t* edos = malloc((max_edo + 1) * sizeof(uint32_t));
+    if (!sw.levels || !group || !edos) {
+        fprintf(stderr, "Not enough memory to index up to EDO %lu\n", max_edo);
+        free(primes);
+        free(harms.check_logs);
+        free(sw.chunk_opsls);
+        free(sw.levels);
+        free(group);
+        free(edos);
+        return 1;
+    }
+    show_consistent_edos(sw, &harms, max_edo, threads);
+    free(primes);
+    free(harms.check_logs);
+    free(sw.chunk_opsls);
+    // counting sort of the EDOs by their largest consistent OPSL
+    for (unsigned long i = 0; i < max_edo; ++i)
+        ++*(group + *(sw.levels + i) + 1);
+    for (unsigned long v = 0; v <= limit; ++v)
+        *(group + v + 1) += *(group + v);
+    for (unsigned long i = 0; i < max_edo; ++i)
+        *(edos + (*(group + *(sw.levels + i)))++) = (uint32_t)(i + 1);
+    for (unsigned long v = limit + 1; v > 0; --v)
+        *(group + v) = *(group + v - 1);
+    *group = 0;
+    struct index_header header = { .magic = "OPSLINDX",
+        .version = INDEX_VERSION, .opsl_limit = (uint32_t)limit,
+        .max_edo = max_edo };
+    header.levels_offset = sizeof(header);
+    header.group_offset = (header.levels_offset + max_edo * sizeof(uint16_t)
+        + 7) / 8 * 8;
+    header.edos_offset = header.group_offset + (limit + 2) * sizeof(uint64_t);
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    FILE* out = fopen(tmp, "wb");
+    unsigned long zero = 0;
+    int ok = out && fwrite(&header, sizeof(header), 1, out) == 1
+        && fwrite(sw.levels, sizeof(uint16_t), max_edo, out) == max_edo
+        && fwrite(&zero, 1, header.group_offset - header.levels_offset
+            - max_edo * sizeof(uint16_t), out)
+            == header.group_offset - header.levels_offset
+            - max_edo * sizeof(uint16_t)
+        && fwrite(group, sizeof(uint64_t), limit + 2, out) == limit + 2
+        && fwrite(edos, sizeof(uint32_t), max_edo, out) == max_edo;
+    if (out && fclose(out))
+        ok = 0;
+    if (!ok || rename(tmp, file)) {
+        perror(file);
+        remove(tmp);
+    } else {
+        printf("Indexed EDOs 1 to %lu up to OPSL %lu in %s\n", max_edo, limit,
+            file);
+    }
+    free(sw.levels);
+    free(group);
+    free(edos);
+    return ok ? 0 : 1;
+}
+
+// moves group heap[i] down the heap of groups until the EDOs they're at are
+// in order
+void sift_groups(unsigned long* heap, unsigned long size, unsigned long i,
+        const uint32_t** at)
+{
+    unsigned long v = *(heap + i), child;
+    while ((child = 2 * i + 1) < size) {
+        if (child + 1 < size
+                && **(at + *(heap + child + 1)) < **(at + *(heap + child)))
+            ++child;
+        if (**(at + *(heap + child)) >= **(at + v))
+            break;
+        *(heap + i) = *(heap + child);
+        i = child;
+    }
+    *(heap + i) = v;
+}
+
+// whether count pieces of size bytes from offset lie within the file
+int section_fits(unsigned long file_size, unsigned long offset,
+        unsigned long count, unsigned long size)
+{
+    if (offset > file_size)
+        return 0;
+    if (!count || !size)
+        return 1;
+    return size <= (file_size - offset) / count;
+}
+
+// whether a mapped index's sections are all inside it and its group starts
+// go up in order to no more than its EDOs, so queries can trust them
+int index_valid(const struct index_header* header, unsigned long size)
+{
+    if (memcmp(header->magic, "OPSLINDX", 8)
+            || header->version != INDEX_VERSION
+            || header->opsl_limit > UINT16_MAX || header->max_edo > UINT32_MAX
+            || header->levels_offset % 8 || header->group_offset % 8
+            || header->edos_offset % 8
+            || !section_fits(size, header->levels_offset, header->max_edo,
+                sizeof(uint16_t))
+            || !section_fits(size, header->group_offset,
+                header->opsl_limit + 2, sizeof(uint64_t))
+            || !section_fits(size, header->edos_offset, header->max_edo,
+                sizeof(uint32_t)))
+        return 0;
+    const uint64_t* group = (const uint64_t*)((const char*)header
+        + header->group_offset);
+    for (unsigned long v = 0; v <= header->opsl_limit; ++v)
+        if (*(group + v + 1) < *(group + v))
+            return 0;
+    return *(group + header->opsl_limit + 1) <= header->max_edo;
+}
+
+// the next EDO at or after from in a group, its end if there isn't one
+const uint32_t* first_from(const uint32_t* start, const uint32_t* end,
+        unsigned long from)
+{
+    while (start < end) {
+        const uint32_t* middle = start + (end - start) / 2;
+        if (*middle < from)
+            start = middle + 1;
+        else
+            end = middle;
+    }
+    return start;
+}
+
+int query_index(const char* file)
+{
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(file);
+        return 1;
+    }
+    const struct index_header* header = NULL;
+    if ((size_t)st.st_size >= sizeof(struct index_header))
+        header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        header = NULL;
+    if (!header || !index_valid(header, st.st_size)) {
+        printf("%s isn't an opslfinder index\n", file);
+        if (header)
+            munmap((void*)header, st.st_size);
+        return 1;
+    }
+    const char* base = (const char*)header;
+    const uint64_t* group = (const uint64_t*)(base + header->group_offset);
+    const uint32_t* edos = (const uint32_t*)(base + header->edos_offset);
+    unsigned long limit = header->opsl_limit, opsl, first, last, count;
+    const uint32_t** at = malloc((limit + 1) * sizeof(uint32_t*));
+    const uint32_t** end = malloc((limit + 1) * sizeof(uint32_t*));
+    unsigned long* heap = malloc((limit + 1) * sizeof(long)), size;
+    char line[256];
+    while (fgets(line, sizeof(line), stdin)) {
+        if (sscanf(line, "%lu %lu %lu", &opsl, &first, &last) != 3) {
+            if (strspn(line, " \t\r\n") != strlen(line))
+                printf("Queries are: OPSL first-EDO last-EDO\n");
+            continue;
+        }
+        printf("%lu-OPSL, EDOs %lu to %lu: ", opsl, first, last);
+        if (opsl > limit) {
+            printf("past the index's OPSL %lu\n", limit);
+            continue;
+        }
+        if (last > header->max_edo)
+            last = header->max_edo;
+        // every group from this OPSL up is consistent in it
+        size = 0;
+        for (unsigned long v = opsl; v <= limit; ++v) {
+            *(end + v) = edos + *(group + v + 1);
+            *(at + v) = first_from(edos + *(group + v), *(end + v), first);
+            if (*(at + v) < *(end + v) && **(at + v) <= last)
+                *(heap + size++) = v;
+        }
+        for (unsigned long i = size / 2; i-- > 0;)
+            sift_groups(heap, size, i, at);
+        count = 0;
+        while (size && **(at + *heap) <= last) { // smallest EDO first
+            printf(count++ ? ", %lu" : "%lu", (unsigned long)**(at + *heap));
+            if (++*(at + *heap) == *(end + *heap))
+                *heap = *(heap + --size);
+            if (size)
+                sift_groups(heap, size, 0, at);
+        }
+        printf(count ? "\n" : "None\n");
+    }
+    free(at);
+    free(end);
+    free(heap);
+    munmap((void*)header, st.st_size);
+    return 0;
+}
+
+// the OPSL's odd primes, numerators/denominators and consistent EDOs
+int show_opsl(unsigned long limit, unsigned long max_edo, int threads)
+{
+    unsigned long prime_count;
+    unsigned long* primes;
     primes = odd_prime_list(limit, &prime_count);
-    printf("\nOdd primes: ");
+    printf("Odd primes: ");
     if (primes) {
         for (unsigned long i = 0; i < prime_count - 1; ++i)
             printf("%lu, ", *(primes + i));
@@ -178,14 +1055,95 @@ int main()
         return 0;
     }
     printf("\nNumerators/denominators: ");
-    use_in_fractions = at_or_below_limit(limit, primes, prime_count,
-        &use_in_fractions_count);
-    for (unsigned long i = 0; i < use_in_fractions_count - 1; ++i)
-        printf("%lu, ", *(use_in_fractions + i));
-    printf("%lu\n", *(use_in_fractions + use_in_fractions_count - 1));
-    printf("\nConsistent EDOs:\n");
-    show_consistent_edos(use_in_fractions, use_in_fractions_count, max_edo);
+    struct harmonics harms = { 0 };
+    harms.values = at_or_below_limit(limit, primes, prime_count, &harms.count);
+    if (!harms.values) { // too many to keep, so they're checked as they go
+        struct harmonic_stream stream = { .upper = limit, .primes = primes,
+            .prime_count = prime_count };
+        struct stream_errors errors;
+        u128 harm;
+        if (threads < 1)
+            threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads < 1)
+            threads = 1;
+        pick_kernel();
+        errors_init(&errors, max_edo);
+        for (unsigned long i = 0; (harm = next_harmonic(&stream)); ++i) {
+            if (i)
+                printf(", ");
+            print_u128(harm);
+            errors_add(&errors, harm, threads);
+        }
+        free(stream.heap);
+        printf("\n\nConsistent EDOs:\n");
+        show_streamed_edos(&errors, threads);
+        free(primes);
+        return 0;
+    }
+    for (unsigned long i = 0; i < harms.count; ++i)
+        printf(i ? ", %lu" : "%lu", *(harms.values + i));
+    printf("\n\nConsistent EDOs:\n");
+    fflush(stdout);
+    build_logs(&harms);
+    struct edo_sweep sw = { 0 };
+    sw.padded = build_check_logs(limit, primes, prime_count, &harms, NULL);
+    if (!sw.padded) {
+        fprintf(stderr, "Not enough memory for OPSL %lu\n", limit);
+        free(primes);
+        free(harms.values);
+        free(harms.logs);
+        return 1;
+    }
+    show_consistent_edos(sw, &harms, max_edo, threads);
 	free(primes);
-	free(use_in_fractions);
+	free(harms.values);
+	free(harms.logs);
+	free(harms.check_logs);
     return 0;
 }
+
+int main(int argc, char** argv)
+{
+    unsigned long limit, max_edo;
+    int threads = 0;
+    char* file = NULL;
+    // a -j on the end goes for every mode
+    if (argc >= 3 && !strcmp(argv[argc - 2], "-j")) {
+        if (sscanf(argv[argc - 1], "%d", &threads) != 1)
+            argc = 0;
+        argc -= 2;
+    }
+    if (argc == 4 && !strcmp(argv[1], "--max-opsl")
+            && sscanf(argv[2], "%lu", &limit) == 1
+            && sscanf(argv[3], "%lu", &max_edo) == 1)
+        return max_opsl_table(limit, max_edo, threads);
+    if (argc == 5 && !strcmp(argv[1], "--build-index")
+            && sscanf(argv[3], "%lu", &limit) == 1
+            && sscanf(argv[4], "%lu", &max_edo) == 1)
+        return build_index(argv[2], limit, max_edo, threads);
+    if (argc == 3 && !strcmp(argv[1], "--query"))
+        file = argv[2];
+    if (file)
+        return query_index(file);
+    if (argc == 3 && sscanf(argv[1], "%lu", &limit) == 1
+            && sscanf(argv[2], "%lu", &max_edo) == 1)
+        return show_opsl(limit, max_edo, threads);
+    if (argc != 1) {
+        printf("Usage: ./opslfinder [-j threads]\n");
+        printf("       ./opslfinder [OPSL] [max EDO] [-j threads]\n");
+        printf("       ./opslfinder --max-opsl [OPSL] [max EDO] "
+            "[-j threads]\n");
+        printf("       ./opslfinder --build-index [file] [OPSL] [max EDO] "
+            "[-j threads]\n");
+        printf("       ./opslfinder --query [file] < queries\n");
+        return 1;
+    }
+    printf("OPSL to use: ");
+    if (scanf("%lu", &limit) != 1)
+        return 1;
+    printf("\nSearch up to EDO: ");
+    if (scanf("%lu", &max_edo) != 1)
+        return 1;
+    printf("\n");
+    return show_opsl(limit, max_edo, threads);
+}
@@ -5,12 +5,124 @@ all odd harmonics up to the specified limit consistently with less than
 25 percent error. This was used to calculate some of the EDOs on the list on the
 Xenharmonic Wiki's "Minimal consistent EDOs" page.
 
+With no arguments the EDOs are checked one at a time on a single core.
+"-j N" splits the search into chunks that are handed out to N threads
+(0 for all cores), and "-c file" saves a checkpoint to the file every minute
+so that a long search can be resumed after it's stopped. Both print the same
+record table as the single-core search.
+
+"-s start end" searches only the EDOs from start up to (not including) end
+and prints the shard in a short form meant for "-m shard files...", which
+merges shards from any number of machines into the full record table.
+"-p N" splits the range into N shards searched by separate processes on this
+machine and merges them the same way. With "-c file" as well, shard i keeps its
+checkpoint in file.i, so a stopped run resumes with the same -p and range.
+
+The errors are found without calling log() in the main loop: the fractional
+part of log2 of each odd harmonic is stored once as a 128-bit fixed-point
+number, so the position of harmonic h in n-EDO is just n times that number
+wrapped around the octave. The harmonics checked on every EDO step their
+position forward with one addition instead.
+
+Most EDOs never reach the exact check. After q-EDO, where q * log2(h) is
+very nearly a whole number, every harmonic h comes back to almost the same
+place, so the EDOs that can be in tune on 3, 5, ... 13 fall into residue
+classes mod q that are worked out once per few million EDOs. Only the EDOs
+left after intersecting those classes are checked one by one.
+
+The stored steps are only as good as log2q(), so their error is measured at
+startup against natural logs worked out to 256 bits, and every check allows
+for that error times the EDO. The rare position that lands within that
+allowance of 25% is settled by comparing n * ln(h) with m * ln(2) directly
+at 256 bits, so records past 10^12 can be trusted.
+
+Compile with: cc -O2 -pthread purely_consistent.c -lquadmath -lm
+
 Written in June 2024 by Tristan Bay, public domain code
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <quadmath.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define FIRST_EDO 5
+#define LAST_EDO 2000000000000000000
+#define CHUNK_SIZE 4194304 // EDOs handed to a thread at a time
+#define CHUNK_WINDOW 8 // finished chunks per thread allowed to await merging
+#define CHECKPOINT_INTERVAL 60 // seconds between checkpoint saves
+#define MAX_HARMONIC 255 // highest odd harmonic with a fixed-point step
+#define HARMONICS (MAX_HARMONIC / 2) // 3, 5, 7, ..., MAX_HARMONIC
+#define STEPPED 3 // harmonics that are stepped on every EDO instead
+#define FILTERED 6 // harmonics checked on 64 EDOs at once before exact checks
+#define LANE_SLACK 64 // most the top 64 bits can fall behind across a block
+#define SIEVED 6 // harmonics whose admissible EDOs are sieved by residue class
+#define SIEVE_SPAN 4194304 // EDOs covered by one set of sieve patterns
+#define SIEVE_MIN (SIEVE_SPAN / 4) // shorter spans use the block filter
+#define MAX_PERIOD 32768 // longest residue period tried for the sieve
+#define LIMBS 6 // 64-bit words in a wide number, the low 4 after the point
+#define FRACTION_LIMBS 4
+
+typedef unsigned __int128 u128; // fraction of an octave in units of 2^-128
+
+u128 steps[HARMONICS]; // fractional part of log2 of 3, 5, 7, ...
+unsigned long (*filter_block)(long first); // chosen for the CPU in init_steps
+int periods[SIEVED]; // EDO period after which each sieved harmonic barely moves
+u128 step_error; // most any step can be off by, in units of 2^-128
+
+struct wide // unsigned fixed-point number, least significant word first
+{
+	unsigned long w[LIMBS];
+};
+
+struct wide ln_harmonics[HARMONICS], ln_two;
+
+struct sieve
+{
+	unsigned long* pattern[SIEVED]; // 64 periods each, one bit per EDO
+	int word[SIEVED]; // word of each pattern for the current 64 EDOs
+};
+
+struct record
+{
+	int limit;
+	long edo;
+};
+
+void add_record(struct record** records, int* count, int* size,
+	int limit, long edo)
+{
+	if (*count == *size) {
+		*size = *size ? *size * 2 : 16;
+		*records = realloc(*records, *size * sizeof(struct record));
+	}
+	(*records)[*count].limit = limit;
+	(*records)[*count].edo = edo;
+	++(*count);
+}
+
+struct phases // positions of the first STEPPED harmonics in the current EDO
+{
+	long edo;
+	u128 p[STEPPED];
+};
+
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
 
 long double err(int a, long b)
 {
@@ -18,18 +130,779 @@ long double err(int a, long b)
 	return round(c) - c;
 }
 
-int main()
+unsigned long filter_block_portable(long first);
+unsigned long filter_block_avx2(long first);
+unsigned long filter_block_avx512(long first);
+
+void init_steps(void)
+{
+	__float128 l;
+	for (int i = 0; i < HARMONICS; ++i) {
+		l = log2q(2 * i + 3);
+		steps[i] = (u128)ldexpq(l - floorq(l), 128);
+	}
+	// trade the sieve's uncertain residues against the cost of its patterns
+	double cost, best, drift;
+	for (int i = 0; i < SIEVED; ++i) {
+		best = HUGE_VAL;
+		for (int q = 1; q <= MAX_PERIOD; ++q) {
+			drift = fabs(ldexp((double)(long)((steps[i] * (u128)q) >> 64), -64));
+			if (drift * (SIEVE_SPAN / q + 1) >= 0.25)
+				continue;
+			cost = 2.0 * SIEVE_SPAN / q * drift + 64.0 * q / SIEVE_SPAN;
+			if (cost < best) {
+				best = cost;
+				periods[i] = q;
+			}
+		}
+	}
+	filter_block = filter_block_portable;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx512f"))
+		filter_block = filter_block_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		filter_block = filter_block_avx2;
+#endif
+}
+
+/* Just enough fixed-point arithmetic to compute and compare logs to 256 bits.
+Only divisions by single words are needed: ln(n) - ln(n - 1) is
+2 * atanh(1 / (2n - 1)), whose series only divides by whole numbers. */
+
+struct wide wide_add(struct wide a, struct wide b)
+{
+	unsigned long carry = 0;
+	for (int i = 0; i < LIMBS; ++i) {
+		u128 t = (u128)a.w[i] + b.w[i] + carry;
+		a.w[i] = (unsigned long)t;
+		carry = (unsigned long)(t >> 64);
+	}
+	return a;
+}
+
+struct wide wide_sub(struct wide a, struct wide b) // a must be at least b
+{
+	unsigned long borrow = 0;
+	for (int i = 0; i < LIMBS; ++i) {
+		u128 t = (u128)a.w[i] - b.w[i] - borrow;
+		a.w[i] = (unsigned long)t;
+		borrow = (unsigned long)(t >> 64) ? 1 : 0;
+	}
+	return a;
+}
+
+int wide_cmp(struct wide a, struct wide b)
+{
+	for (int i = LIMBS - 1; i >= 0; --i)
+		if (a.w[i] != b.w[i])
+			return a.w[i] > b.w[i] ? 1 : -1;
+	return 0;
+}
+
+struct wide wide_diff(struct wide a, struct wide b) // |a - b|
+{
+	return wide_cmp(a, b) >= 0 ? wide_sub(a, b) : wide_sub(b, a);
+}
+
+struct wide wide_div(struct wide a, unsigned long d)
+{
+	unsigned long rem = 0;
+	for (int i = LIMBS - 1; i >= 0; --i) {
+		u128 t = ((u128)rem << 64) | a.w[i];
+		a.w[i] = (unsigned long)(t / d);
+		rem = (unsigned long)(t % d);
+	}
+	return a;
+}
+
+struct wide wide_mul(struct wide a, unsigned long m)
+{
+	unsigned long carry = 0;
+	for (int i = 0; i < LIMBS; ++i) {
+		u128 t = (u128)a.w[i] * m + carry;
+		a.w[i] = (unsigned long)t;
+		carry = (unsigned long)(t >> 64);
+	}
+	return a;
+}
+
+struct wide wide_mul_wide(struct wide a, struct wide b)
+{
+	unsigned long full[2 * LIMBS] = { 0 }, carry;
+	for (int i = 0; i < LIMBS; ++i) {
+		carry = 0;
+		for (int j = 0; j < LIMBS; ++j) {
+			u128 t = (u128)a.w[i] * b.w[j] + full[i + j] + carry;
+			full[i + j] = (unsigned long)t;
+			carry = (unsigned long)(t >> 64);
+		}
+		full[i + LIMBS] = carry;
+	}
+	struct wide product;
+	memcpy(product.w, full + FRACTION_LIMBS, sizeof(product.w));
+	return product;
+}
+
+struct wide wide_atanh_inverse(unsigned long k) // atanh(1 / k), k > 1
+{
+	struct wide term = { 0 }, sum;
+	term.w[FRACTION_LIMBS] = 1;
+	term = wide_div(term, k);
+	sum = term;
+	for (unsigned long j = 3; wide_cmp(term, (struct wide){ 0 }); j += 2) {
+		term = wide_div(term, k * k);
+		sum = wide_add(sum, wide_div(term, j));
+	}
+	return sum;
+}
+
+void init_logs(void)
+{
+	struct wide ln = { 0 }; // ln(1)
+	for (unsigned long n = 2; n <= MAX_HARMONIC; ++n) {
+		ln = wide_add(ln, wide_mul(wide_atanh_inverse(2 * n - 1), 2));
+		if (n == 2)
+			ln_two = ln;
+		else if (n % 2)
+			ln_harmonics[n / 2 - 1] = ln;
+	}
+	// the error of a step is |(whole part + step) * ln(2) - ln(h)| / ln(2)
+	struct wide log2_h, d;
+	for (int i = 0; i < HARMONICS; ++i) {
+		log2_h = (struct wide){ 0 };
+		log2_h.w[FRACTION_LIMBS] = 63 - __builtin_clzl(2 * i + 3);
+		log2_h.w[FRACTION_LIMBS - 1] = (unsigned long)(steps[i] >> 64);
+		log2_h.w[FRACTION_LIMBS - 2] = (unsigned long)steps[i];
+		d = wide_diff(wide_mul_wide(log2_h, ln_two), ln_harmonics[i]);
+		u128 units = ((u128)d.w[FRACTION_LIMBS - 1] << 64)
+			| d.w[FRACTION_LIMBS - 2]; // d in units of 2^-128
+		if (d.w[FRACTION_LIMBS] || units >> 125) {
+			fprintf(stderr, "log2q() is too far off for harmonic %d\n", 2 * i + 3);
+			exit(EXIT_FAILURE);
+		}
+		units = units * 3 / 2 + 2; // 1/ln(2) < 3/2, plus the cut-off bits
+		if (units > step_error)
+			step_error = units;
+	}
+}
+
+unsigned long phase_slack(long edo) // error allowed in the top 64 bits
+{
+	return (unsigned long)(((u128)edo * step_error) >> 64) + 2;
+}
+
+_Bool confirm_in_tune(int i, long edo) // settles positions close to 25%
+{
+	unsigned long m = (unsigned long)edo * (63 - __builtin_clzl(2 * i + 3))
+		+ (unsigned long)(((u128)edo * (unsigned long)(steps[i] >> 64)
+		+ (((u128)edo * (unsigned long)steps[i]) >> 64)) >> 64);
+	// edo * ln(h) - m * ln(2) is ln(2) times the position in the octave
+	struct wide x = wide_sub(wide_mul(ln_harmonics[i], edo),
+		wide_mul(ln_two, m));
+	struct wide quarter = wide_div(ln_two, 4);
+	struct wide three_quarters = wide_sub(ln_two, quarter);
+	struct wide margin = wide_diff(x, wide_cmp(x, wide_div(ln_two, 2)) < 0
+		? quarter : three_quarters);
+	if (!margin.w[FRACTION_LIMBS - 1] && !margin.w[FRACTION_LIMBS - 2]
+			&& !margin.w[FRACTION_LIMBS] && !margin.w[FRACTION_LIMBS + 1])
+		fprintf(stderr, "Harmonic %d in %ldedo is within 2^-128 of 25%%\n",
+			2 * i + 3, edo);
+	return wide_cmp(x, quarter) < 0 || wide_cmp(x, three_quarters) > 0;
+}
+
+_Bool in_tune(u128 phase) // less than 25% error either way
+{
+	// the rejected positions [1/4, 3/4] of the octave are moved to [0, 1/2]
+	return phase - ((u128)1 << 126) > ((u128)1 << 127);
+}
+
+_Bool harmonic_in_tune(int i, long edo, u128 phase, unsigned long slack)
+{
+	unsigned long hi = (unsigned long)(phase >> 64);
+	if (hi - ((1UL << 62) - slack) <= 2 * slack
+			|| hi - ((3UL << 62) - slack) <= 2 * slack)
+		return confirm_in_tune(i, edo);
+	return in_tune(phase);
+}
+
+_Bool maybe_in_tune(u128 phase, unsigned long slack) // allowing for slack
+{
+	unsigned long hi = (unsigned long)(phase >> 64);
+	return hi - ((1UL << 62) + slack) > (1UL << 63) - 2 * slack - 1;
+}
+
+int consistency_limit(long edo, int from) // starting at harmonic from
+{
+	int i = from / 2 - 1;
+	unsigned long slack = phase_slack(edo);
+	while (i < HARMONICS
+			&& harmonic_in_tune(i, edo, steps[i] * (u128)edo, slack))
+		++i;
+	if (i < HARMONICS)
+		return 2 * i + 1;
+	int counter = MAX_HARMONIC + 2; // far beyond anything reachable
+	while (fabsl(err(counter, edo)) < 0.25)
+		counter += 2;
+	return counter - 2;
+}
+
+void start_phases(struct phases* ph, long edo)
+{
+	ph->edo = edo;
+	for (int i = 0; i < STEPPED; ++i)
+		ph->p[i] = steps[i] * (u128)edo;
+}
+
+int next_limit(struct phases* ph) // limit of the current EDO, then steps on
+{
+	int i = 0;
+	unsigned long slack = phase_slack(ph->edo);
+	while (i < STEPPED && harmonic_in_tune(i, ph->edo, ph->p[i], slack))
+		++i;
+	int limit = i < STEPPED ? 2 * i + 1 : consistency_limit(ph->edo, 2 * i + 3);
+	for (i = 0; i < STEPPED; ++i)
+		ph->p[i] += steps[i];
+	++ph->edo;
+	return limit;
+}
+
+/* The block filters only look at the top 64 bits of each position, stepping
+from the exact position of the first EDO in the block. The dropped low bits
+can only carry into the top bits, so lane k is at most k units behind, and an
+EDO is only thrown out if it's off by 25% or more even with that and the
+error of the step. The EDOs left in the returned bit mask get the exact check
+afterwards. */
+
+unsigned long filter_block_portable(long first)
+{
+	unsigned long survivors = ~0UL, hi, step, bits;
+	unsigned long slack = phase_slack(first + 64);
+	for (int i = 0; i < FILTERED && survivors; ++i) {
+		hi = (unsigned long)((steps[i] * (u128)first) >> 64);
+		step = (unsigned long)(steps[i] >> 64);
+		bits = 0;
+		for (int k = 0; k < 64; ++k, hi += step)
+			if (hi - ((1UL << 62) + slack)
+					> (1UL << 63) - LANE_SLACK - 2 * slack - 1)
+				bits |= 1UL << k;
+		survivors &= bits;
+	}
+	return survivors;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+unsigned long filter_block_avx2(long first)
+{
+	unsigned long survivors = ~0UL, bits, step;
+	unsigned long slack = phase_slack(first + 64);
+	// signed compare of (position - 1/4) with the sign bit flipped
+	__m256i quarter = _mm256_set1_epi64x((1L << 62) + (1UL << 63) + slack);
+	__m256i bound = _mm256_set1_epi64x(-LANE_SLACK - 2 * slack - 1);
+	__m256i hi, step4;
+	for (int i = 0; i < FILTERED && survivors; ++i) {
+		long base = (long)((steps[i] * (u128)first) >> 64);
+		step = (unsigned long)(steps[i] >> 64);
+		hi = _mm256_set_epi64x(base + 3 * step, base + 2 * step,
+			base + step, base);
+		step4 = _mm256_set1_epi64x(4 * step);
+		bits = 0;
+		for (int k = 0; k < 64; k += 4) {
+			__m256i keep = _mm256_cmpgt_epi64(
+				_mm256_sub_epi64(hi, quarter), bound);
+			bits |= (unsigned long)_mm256_movemask_pd(
+				_mm256_castsi256_pd(keep)) << k;
+			hi = _mm256_add_epi64(hi, step4);
+		}
+		survivors &= bits;
+	}
+	return survivors;
+}
+
+__attribute__((target("avx512f")))
+unsigned long filter_block_avx512(long first)
+{
+	unsigned long survivors = ~0UL, bits, step;
+	unsigned long slack = phase_slack(first + 64);
+	__m512i quarter = _mm512_set1_epi64((1L << 62) + slack);
+	__m512i bound = _mm512_set1_epi64((1UL << 63) - LANE_SLACK - 2 * slack - 1);
+	__m512i hi, step8;
+	for (int i = 0; i < FILTERED && survivors; ++i) {
+		long base = (long)((steps[i] * (u128)first) >> 64);
+		step = (unsigned long)(steps[i] >> 64);
+		hi = _mm512_set_epi64(base + 7 * step, base + 6 * step,
+			base + 5 * step, base + 4 * step, base + 3 * step, base + 2 * step,
+			base + step, base);
+		step8 = _mm512_set1_epi64(8 * step);
+		bits = 0;
+		for (int k = 0; k < 64; k += 8) {
+			bits |= (unsigned long)_mm512_cmpgt_epu64_mask(
+				_mm512_sub_epi64(hi, quarter), bound) << k;
+			hi = _mm512_add_epi64(hi, step8);
+		}
+		survivors &= bits;
+	}
+	return survivors;
+}
+#endif
+
+/* Over n periods of q EDOs, each residue class moves around the octave by at
+most n times the tiny drift of q-EDO, so whether it's in tune can only change
+once. If both ends of a class are out of tune, so is everything in between,
+and the whole class is left out of the pattern (allowing for the error of the
+step). Since the 64 bit positions of
+a pattern word are 64 periods apart in each class, the same q words repeat for
+the whole span. */
+
+void build_sieve(struct sieve* sv, long first, long span)
+{
+	unsigned long slack = phase_slack(first + span + MAX_PERIOD);
+	for (int i = 0; i < SIEVED; ++i) {
+		int q = periods[i];
+		unsigned long* pattern = sv->pattern[i];
+		memset(pattern, 0, q * sizeof(long));
+		u128 start = steps[i] * (u128)first;
+		u128 end = steps[i] * (u128)(first + (span + q - 1) / q * q);
+		for (int r = 0; r < q; ++r, start += steps[i], end += steps[i]) {
+			if (maybe_in_tune(start, slack) || maybe_in_tune(end, slack))
+				for (long j = r; j < 64L * q; j += q)
+					pattern[j >> 6] |= 1UL << (j & 63);
+		}
+		sv->word[i] = 0;
+	}
+}
+
+int check_block(long first, unsigned long survivors, int recordlimit,
+	struct record** records, int* count, int* size)
+{
+	int limit;
+	while (survivors) {
+		long edo = first + __builtin_ctzl(survivors);
+		survivors &= survivors - 1;
+		limit = consistency_limit(edo, 3);
+		if (limit > recordlimit) {
+			recordlimit = limit;
+			add_record(records, count, size, limit, edo);
+		}
+	}
+	return recordlimit;
+}
+
+int scan_range(long first, long last, int recordlimit,
+	struct record** records, int* count, int* size)
+{
+	long i = first;
+	int limit;
+	struct phases ph;
+	start_phases(&ph, first);
+	// until the record passes the sieved harmonics every EDO can set one
+	for (; i < last && (recordlimit < 2 * SIEVED + 1
+			|| recordlimit < 2 * FILTERED + 1); ++i) {
+		limit = next_limit(&ph);
+		if (limit > recordlimit) {
+			recordlimit = limit;
+			add_record(records, count, size, limit, i);
+		}
+	}
+	struct sieve sv;
+	for (int h = 0; h < SIEVED; ++h)
+		sv.pattern[h] = malloc(periods[h] * sizeof(long));
+	while (i + 64 <= last) {
+		long span = (last - i) / 64 * 64;
+		if (span > SIEVE_SPAN)
+			span = SIEVE_SPAN;
+		if (span >= SIEVE_MIN) {
+			build_sieve(&sv, i, span);
+			for (long end = i + span; i < end; i += 64) {
+				unsigned long survivors = ~0UL;
+				for (int h = 0; h < SIEVED; ++h) {
+					survivors &= sv.pattern[h][sv.word[h]];
+					if (++sv.word[h] == periods[h])
+						sv.word[h] = 0;
+				}
+				recordlimit = check_block(i, survivors, recordlimit,
+					records, count, size);
+			}
+		} else {
+			for (long end = i + span; i < end; i += 64)
+				recordlimit = check_block(i, filter_block(i), recordlimit,
+					records, count, size);
+		}
+	}
+	for (int h = 0; h < SIEVED; ++h)
+		free(sv.pattern[h]);
+	for (; i < last; ++i) {
+		limit = consistency_limit(i, 3);
+		if (limit > recordlimit) {
+			recordlimit = limit;
+			add_record(records, count, size, limit, i);
+		}
+	}
+	return recordlimit;
+}
+
+struct chunk
+{
+	struct record* records;
+	int count, size;
+	_Bool done;
+};
+
+struct scan
+{
+	long start, end, chunk_count, next_chunk, merged;
+	int recordlimit, window;
+	struct chunk* chunks; // ring buffer of window slots indexed by chunk
+	struct record* table; // every record printed so far, for checkpoints
+	int table_count, table_size;
+	FILE* shard; // where shard records go, or NULL for the record table
+	const char* checkpoint;
+	time_t last_save;
+	pthread_mutex_t lock;
+	pthread_cond_t merged_cond;
+};
+
+struct shard // one shard's output read back in for merging
 {
-	int recordlimit = 1, counter;
-	for (long i = 5; i < 2000000000000000000; ++i) {
-		counter = 3;
-		while (fabs(err(counter, i)) < 0.25) {
-			if (counter > recordlimit) {
-				recordlimit = counter;
-				printf("%d:\t%ld\n", recordlimit, i);
+	long start, end;
+	struct record* records;
+	int count, size;
+};
+
+void print_record(struct scan* s, int limit, long edo)
+{
+	if (s->shard)
+		fprintf(s->shard, "%d %ld\n", limit, edo);
+	else
+		printf("%d:\t%ld\n", limit, edo);
+}
+
+void save_checkpoint(struct scan* s)
+{
+	char tmp[strlen(s->checkpoint) + 5];
+	sprintf(tmp, "%s.tmp", s->checkpoint);
+	FILE* f = fopen(tmp, "w");
+	if (!f) {
+		perror(tmp);
+		return;
+	}
+	long next = s->start + s->merged * CHUNK_SIZE;
+	fprintf(f, "%ld\n", next < s->end ? next : s->end);
+	for (int i = 0; i < s->table_count; ++i)
+		fprintf(f, "%d:\t%ld\n", s->table[i].limit, s->table[i].edo);
+	if (fclose(f) == 0)
+		rename(tmp, s->checkpoint);
+	s->last_save = time(NULL);
+}
+
+_Bool load_checkpoint(struct scan* s)
+{
+	FILE* f = fopen(s->checkpoint, "r");
+	if (!f)
+		return 0;
+	int limit;
+	long edo;
+	if (fscanf(f, "%ld", &s->start) != 1) {
+		fclose(f);
+		return 0;
+	}
+	while (fscanf(f, "%d:%ld", &limit, &edo) == 2) {
+		add_record(&s->table, &s->table_count, &s->table_size, limit, edo);
+		s->recordlimit = limit;
+		print_record(s, limit, edo);
+	}
+	fclose(f);
+	return 1;
+}
+
+void merge_chunks(struct scan* s) // called with the lock held
+{
+	struct chunk* c = &s->chunks[s->merged % s->window];
+	while (s->merged < s->chunk_count && c->done) {
+		// a record within the chunk is only a global record if it beats
+		// everything from the earlier chunks, which keeps the serial order
+		for (int i = 0; i < c->count; ++i) {
+			if (s->shard && c->records[i].limit > s->recordlimit) {
+				s->recordlimit = c->records[i].limit;
+				print_record(s, s->recordlimit, c->records[i].edo);
+				add_record(&s->table, &s->table_count, &s->table_size,
+					s->recordlimit, c->records[i].edo);
+			}
+			while (c->records[i].limit > s->recordlimit) {
+				s->recordlimit += 2;
+				print_record(s, s->recordlimit, c->records[i].edo);
+				add_record(&s->table, &s->table_count, &s->table_size,
+					s->recordlimit, c->records[i].edo);
+			}
+		}
+		fflush(s->shard ? s->shard : stdout);
+		c->count = 0;
+		c->done = 0;
+		++s->merged;
+		c = &s->chunks[s->merged % s->window];
+	}
+	if (s->checkpoint && time(NULL) - s->last_save >= CHECKPOINT_INTERVAL)
+		save_checkpoint(s);
+	pthread_cond_broadcast(&s->merged_cond);
+}
+
+void* scan_worker(void* arg)
+{
+	struct scan* s = arg;
+	struct record* records = NULL;
+	int count, size = 0, recordlimit;
+	pthread_mutex_lock(&s->lock);
+	for (;;) {
+		while (s->next_chunk < s->chunk_count
+				&& s->next_chunk >= s->merged + s->window)
+			pthread_cond_wait(&s->merged_cond, &s->lock);
+		if (s->next_chunk >= s->chunk_count || stop_requested)
+			break;
+		long index = s->next_chunk++;
+		recordlimit = s->recordlimit; // nothing at or below this gets printed
+		pthread_mutex_unlock(&s->lock);
+		long first = s->start + index * CHUNK_SIZE;
+		long last = s->end - first > CHUNK_SIZE ? first + CHUNK_SIZE : s->end;
+		count = 0;
+		scan_range(first, last, recordlimit, &records, &count, &size);
+		pthread_mutex_lock(&s->lock);
+		struct chunk* c = &s->chunks[index % s->window];
+		for (int i = 0; i < count; ++i)
+			add_record(&c->records, &c->count, &c->size,
+				records[i].limit, records[i].edo);
+		c->done = 1;
+		merge_chunks(s);
+	}
+	pthread_mutex_unlock(&s->lock);
+	free(records);
+	return NULL;
+}
+
+int parallel_scan(int threads, const char* checkpoint, long start, long end,
+	FILE* shard)
+{
+	struct scan s = { 0 };
+	s.start = start;
+	s.end = end;
+	s.recordlimit = 1;
+	s.shard = shard;
+	s.checkpoint = checkpoint;
+	s.last_save = time(NULL);
+	if (shard)
+		fprintf(shard, "start %ld\n", start);
+	if (checkpoint && load_checkpoint(&s))
+		fprintf(stderr, "Resuming from EDO %ld\n", s.start);
+	fflush(shard ? shard : stdout);
+	if (threads < 1)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+	s.chunk_count = (s.end - s.start + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	s.window = threads * CHUNK_WINDOW;
+	s.chunks = calloc(s.window, sizeof(struct chunk));
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.merged_cond, NULL);
+	signal(SIGINT, request_stop); // finish the chunks in progress and save
+	signal(SIGTERM, request_stop);
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, scan_worker, &s);
+	for (int i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	if (checkpoint)
+		save_checkpoint(&s);
+	if (shard && s.merged == s.chunk_count) // only finished shards get merged
+		fprintf(shard, "end %ld\n", end);
+	for (int i = 0; i < s.window; ++i)
+		free(s.chunks[i].records);
+	free(s.chunks);
+	free(s.table);
+	return s.merged == s.chunk_count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Shard output starts with "start A", then has one "limit EDO" line for each
+EDO in [A, B) that is consistent in a higher odd limit than any EDO before it
+in the shard, and ends with "end B" once the whole shard has been searched.
+The minimal EDO for a limit is the smallest of each shard's first EDO that
+reaches it. */
+
+_Bool read_shard(FILE* f, struct shard* sh)
+{
+	char line[64];
+	int limit;
+	long edo;
+	sh->start = sh->end = -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "start %ld", &edo) == 1)
+			sh->start = edo;
+		else if (sscanf(line, "end %ld", &edo) == 1)
+			sh->end = edo;
+		else if (sscanf(line, "%d %ld", &limit, &edo) == 2)
+			add_record(&sh->records, &sh->count, &sh->size, limit, edo);
+	}
+	return sh->start >= 0 && sh->end >= 0;
+}
+
+int compare_shards(const void* x, const void* y)
+{
+	long a = ((const struct shard*)x)->start, b = ((const struct shard*)y)->start;
+	return (a > b) - (a < b);
+}
+
+void merge_shards(struct shard* shards, int count)
+{
+	qsort(shards, count, sizeof(struct shard), compare_shards);
+	long covered = FIRST_EDO;
+	int top = 1;
+	for (int i = 0; i < count; ++i) {
+		if (shards[i].start > covered)
+			fprintf(stderr, "Warning: EDOs %ld to %ld are in no shard\n",
+				covered, shards[i].start - 1);
+		if (shards[i].end > covered)
+			covered = shards[i].end;
+		for (int j = 0; j < shards[i].count; ++j)
+			if (shards[i].records[j].limit > top)
+				top = shards[i].records[j].limit;
+	}
+	for (int limit = 3; limit <= top; limit += 2) {
+		long best = -1;
+		for (int i = 0; i < count; ++i) {
+			for (int j = 0; j < shards[i].count; ++j) {
+				if (shards[i].records[j].limit >= limit) {
+					if (best < 0 || shards[i].records[j].edo < best)
+						best = shards[i].records[j].edo;
+					break;
+				}
+			}
+		}
+		printf("%d:\t%ld\n", limit, best);
+	}
+}
+
+int merge_files(char** names, int count)
+{
+	struct shard shards[count];
+	memset(shards, 0, sizeof(shards));
+	for (int i = 0; i < count; ++i) {
+		FILE* f = fopen(names[i], "r");
+		if (!f) {
+			perror(names[i]);
+			return EXIT_FAILURE;
+		}
+		if (!read_shard(f, &shards[i])) {
+			fprintf(stderr, "%s is not a finished shard\n", names[i]);
+			return EXIT_FAILURE;
+		}
+		fclose(f);
+	}
+	merge_shards(shards, count);
+	for (int i = 0; i < count; ++i)
+		free(shards[i].records);
+	return EXIT_SUCCESS;
+}
+
+int local_shards(int processes, int threads, const char* checkpoint,
+	long start, long end)
+{
+	// each child process searches its own shard into a temporary file
+	FILE* files[processes];
+	pid_t children[processes];
+	char shard_checkpoint[checkpoint ? strlen(checkpoint) + 16 : 1];
+	for (int i = 0; i < processes; ++i) {
+		long first = start + (end - start) / processes * i;
+		long last = i == processes - 1 ? end
+			: start + (end - start) / processes * (i + 1);
+		files[i] = tmpfile();
+		fflush(stdout);
+		children[i] = fork();
+		if (children[i] < 0) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (!children[i]) {
+			if (checkpoint)
+				sprintf(shard_checkpoint, "%s.%d", checkpoint, i + 1);
+			int status = parallel_scan(threads < 0 ? 1 : threads,
+				checkpoint ? shard_checkpoint : NULL, first, last, files[i]);
+			fclose(files[i]);
+			_exit(status);
+		}
+	}
+	if (checkpoint) { // let the shards save on ^C and say which didn't finish
+		signal(SIGINT, SIG_IGN);
+		signal(SIGTERM, SIG_IGN);
+	}
+	struct shard shards[processes];
+	memset(shards, 0, sizeof(shards));
+	int status = EXIT_SUCCESS;
+	for (int i = 0; i < processes; ++i) {
+		waitpid(children[i], NULL, 0);
+		rewind(files[i]);
+		if (!read_shard(files[i], &shards[i])) {
+			fprintf(stderr, "Shard %d was stopped before it finished\n", i + 1);
+			status = EXIT_FAILURE;
+		}
+		fclose(files[i]);
+	}
+	if (status == EXIT_SUCCESS)
+		merge_shards(shards, processes);
+	for (int i = 0; i < processes; ++i)
+		free(shards[i].records);
+	return status;
+}
+
+int main(int argc, char** argv)
+{
+	int threads = -1, processes = 0;
+	const char* checkpoint = NULL;
+	long start = FIRST_EDO, end = LAST_EDO;
+	_Bool sharded = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+			checkpoint = argv[++i];
+		} else if (!strcmp(argv[i], "-s") && i + 2 < argc) {
+			sscanf(argv[++i], "%ld", &start);
+			sscanf(argv[++i], "%ld", &end);
+			sharded = 1;
+		} else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+			processes = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+			return merge_files(argv + i + 1, argc - i - 1);
+		} else {
+			printf("Usage: ./purely_consistent [-j threads] [-c file] "
+				"[-s start end] [-p processes]\n");
+			printf("       ./purely_consistent -m shard_file...\n");
+			return 1;
+		}
+	}
+	if (start < 1 || end <= start) {
+		printf("The shard must be a range of EDOs [start, end)\n");
+		return 1;
+	}
+	init_steps();
+	init_logs();
+	if (processes > 0)
+		return local_shards(processes, threads, checkpoint, start, end);
+	if (sharded)
+		return parallel_scan(threads < 0 ? 1 : threads, checkpoint,
+			start, end, stdout);
+	if (threads >= 0 || checkpoint)
+		return parallel_scan(threads, checkpoint, start, end, NULL);
+	int recordlimit = 1, count, size = 0;
+	struct record* records = NULL;
+	for (long i = FIRST_EDO; i < LAST_EDO; i += CHUNK_SIZE) {
+		count = 0;
+		scan_range(i, LAST_EDO - i > CHUNK_SIZE ? i + CHUNK_SIZE : LAST_EDO,
+			recordlimit, &records, &count, &size);
+		for (int j = 0; j < count; ++j) {
+			while (records[j].limit > recordlimit) {
+				recordlimit += 2;
+				printf("%d:\t%ld\n", recordlimit, records[j].edo);
 			}
-			counter += 2;
 		}
 	}
+	free(records);
 	return 0;
 }
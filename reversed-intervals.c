@@ -1,14 +1,103 @@
 /* Reversed intervals script by Tristan Bay:
  * Finds the largest negatively-mapped superparticular interval
  * in the patent val of a given EDO
+ *
+ * With --range A B every EDO from A to B is checked. The smallest prime
+ * factor of every harmonic is found once, so each harmonic's mapping is
+ * the mapping of the harmonic divided by that prime plus the prime's val,
+ * and the mappings stop as soon as the first reversal turns up. Blocks of
+ * EDOs are handed out to -j threads (all cores unless it's given) and
+ * printed in order.
+ *
+ * Within a block the val isn't rebuilt for every EDO: from one EDO to the
+ * next each prime's val goes up by the floor of log2(p), or one more when
+ * the new position is at least halfway past that, which is what round()
+ * would give anyway. The mappings only ever need one table lookup each.
+ *
+ * --max-harmonic N looks for reversals up to N/(N-1) instead of 65536/65535
+ * (--best-val only goes as far as the table). Past the table the harmonics
+ * are streamed through in segments: every prime up to the square root of N
+ * walks its multiples (and those of its powers) in the segment, and
+ * whatever is left over of a harmonic is a single prime whose val is worked
+ * out there and then. That needs only the primes up to sqrt(N) and one
+ * segment of memory, and each EDO stops at its first reversal.
+ *
+ * --best-val EDO [-k K] looks for the val, within K steps of the patent val
+ * on each prime but 2, that goes longest before its first reversal. Primes
+ * are picked in order. Once one is picked, every pair of neighbouring
+ * harmonics with it in gets a tighter range of mappings, taking the primes
+ * still to come anywhere within K of patent. A pair that has to reverse caps
+ * what the rest of that branch can reach, and the branch is dropped once
+ * the cap is no better than the best val so far. A dead end remembers the
+ * primes in the pairs that ended it and goes straight back to the latest
+ * of them, rather than trying every val of the primes in between.
+ *
+ * Compile with: cc -O2 -pthread reversed-intervals.c -lm
  * Written October 2024 and October 2025, public domain code
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 #define PRIMECOUNT 6542
 #define SIEVEBOUND 65536.0
+#define EDO_BLOCK 256 // EDOs handed to a thread at a time
+#define BLOCK_WINDOW 8 // finished blocks per thread allowed to await printing
+#define STREAM_SEGMENT 65536 // harmonics mapped at a time past the table
+
+int spf[(int)SIEVEBOUND + 1]; // smallest prime factor of each harmonic
+int spf_index[(int)SIEVEBOUND + 1]; // which prime that is, 2 being the 0th
+int cofactor[(int)SIEVEBOUND + 1]; // n over its smallest prime factor
+int range_primes[PRIMECOUNT];
+double log2_primes[PRIMECOUNT];
+int prime_steps[PRIMECOUNT]; // floor of log2 of each prime
+int range_prime_count;
+long long max_harmonic = (long long)SIEVEBOUND;
+int table_limit = (int)SIEVEBOUND; // harmonics mapped from the spf table
+int* base_primes; // every prime up to sqrt(max_harmonic)
+double* base_log2;
+int base_count;
+
+struct block
+{
+	long long reversals[EDO_BLOCK]; // denominator of the first reversal, or 0
+	_Bool done;
+};
+
+struct stream // one thread's segment of harmonics past the table
+{
+	long long* found; // product of the factors found so far
+	long long* hm;
+	int* val; // of each base prime
+};
+
+struct val_search
+{
+	int edo, k, limit, prime_count; // primes up to limit
+	int* patent;
+	int* val;
+	int* best_val;
+	int best; // denominator of the best first reversal, limit if none
+	_Bool done; // no reversal at all, nothing can beat that
+	int* pair_start; // n of each pair n-1, n with the prime in either
+	int* pairs;
+	int words; // in a set of primes
+	uint64_t* conflicts; // by prime, the earlier primes its dead ends came from
+	uint64_t* reasons; // by prime, those behind the cap it last passed on
+	_Bool* chronological; // a val was found below it, so no jumping past
+};
+
+struct sweep
+{
+	int first, last, block_count, next_block, printed, window;
+	struct block* blocks; // ring buffer of window slots
+	pthread_mutex_t lock;
+	pthread_cond_t printed_cond;
+};
 
 void sieve(int* primes, int len)
 {
@@ -60,14 +149,435 @@ int first_reversal(int* hm, int len)
 	return 0; // if no reversals found
 }
 
+void build_spf(void)
+{
+	for (int i = 2; i <= (int)SIEVEBOUND; ++i) {
+		if (spf[i])
+			continue;
+		range_primes[range_prime_count] = i;
+		// worked out as in generate_val so the rounding comes out the same
+		log2_primes[range_prime_count] = log((double)i) / log(2.0);
+		prime_steps[range_prime_count] = (int)log2_primes[range_prime_count];
+		for (int j = i; j <= (int)SIEVEBOUND; j += i) {
+			if (!spf[j]) {
+				spf[j] = i;
+				spf_index[j] = range_prime_count;
+				cofactor[j] = j / i;
+			}
+		}
+		++range_prime_count;
+	}
+}
+
+void build_base_primes(void)
+{
+	int root = (int)sqrtl((long double)max_harmonic);
+	while ((long long)(root + 1) * (root + 1) <= max_harmonic)
+		++root;
+	while ((long long)root * root > max_harmonic)
+		--root;
+	char* composite = calloc(root + 1, 1);
+	base_primes = malloc((root / 2 + 2) * sizeof(int));
+	base_log2 = malloc((root / 2 + 2) * sizeof(double));
+	for (int i = 2; i <= root; ++i) {
+		if (composite[i])
+			continue;
+		base_primes[base_count] = i;
+		base_log2[base_count++] = log((double)i) / log(2.0);
+		for (long long j = (long long)i * i; j <= root; j += i)
+			composite[j] = 1;
+	}
+	free(composite);
+}
+
+void stream_init(struct stream* st)
+{
+	st->found = malloc(STREAM_SEGMENT * sizeof(long long));
+	st->hm = malloc(STREAM_SEGMENT * sizeof(long long));
+	st->val = malloc((base_count + 1) * sizeof(int));
+}
+
+void stream_free(struct stream* st)
+{
+	free(st->found);
+	free(st->hm);
+	free(st->val);
+}
+
+// carries on from harmonic `from`, the one before it mapping to prev,
+// and gives the denominator of the first reversal up to max_harmonic
+long long stream_reversal(int edo, long long from, long long prev,
+	struct stream* st)
+{
+	for (int j = 0; j < base_count; ++j)
+		st->val[j] = (int)round(base_log2[j] * edo);
+	for (long long lo = from; lo <= max_harmonic; lo += STREAM_SEGMENT) {
+		long long hi = max_harmonic - lo < STREAM_SEGMENT
+			? max_harmonic : lo + STREAM_SEGMENT - 1;
+		int len = (int)(hi - lo + 1);
+		for (int i = 0; i < len; ++i) {
+			st->found[i] = 1;
+			st->hm[i] = 0;
+		}
+		for (int j = 0; j < base_count; ++j) {
+			long long p = base_primes[j];
+			if (p * p > hi)
+				break;
+			for (long long pk = p;; pk *= p) { // each power marks its multiples
+				for (long long m = (lo + pk - 1) / pk * pk; m <= hi; m += pk) {
+					st->found[m - lo] *= p;
+					st->hm[m - lo] += st->val[j];
+				}
+				if (pk > hi / p)
+					break;
+			}
+		}
+		for (int i = 0; i < len; ++i) {
+			long long n = lo + i;
+			if (st->found[i] != n) // one prime above sqrt(n) left over
+				st->hm[i] += (long long)round(log((double)(n / st->found[i]))
+					/ log(2.0) * edo);
+			if (st->hm[i] < prev)
+				return n - 1;
+			prev = st->hm[i];
+		}
+	}
+	return 0;
+}
+
+// first reversals of count EDOs from first, the same as generate_val,
+// generate_harmonic_mappings and first_reversal would give
+void block_reversals(int first, int count, long long* reversals, int* val,
+	int* hm, struct stream* st)
+{
+	int edo, step;
+	for (int j = 0; j < range_prime_count; ++j)
+		val[j] = (int)round(log2_primes[j] * first);
+	hm[1] = 0;
+	for (int i = 0; i < count; ++i) {
+		edo = first + i;
+		for (int j = 0; i && j < range_prime_count; ++j) {
+			step = val[j] + prime_steps[j];
+			val[j] = log2_primes[j] * edo >= step + 0.5 ? step + 1 : step;
+		}
+		reversals[i] = 0;
+		int n;
+		for (n = 2; n <= table_limit; ++n) {
+			hm[n] = hm[cofactor[n]] + val[spf_index[n]];
+			if (hm[n] < hm[n - 1]) {
+				reversals[i] = n - 1;
+				break;
+			}
+		}
+		if (n > table_limit && max_harmonic > table_limit)
+			reversals[i] = stream_reversal(edo, n, hm[n - 1], st);
+	}
+}
+
+void print_reversal(int edo, long long reversal)
+{
+	if (!reversal)
+		printf("No superparticular reversals found for %dedo\n", edo);
+	else
+		printf("First superparticular reversal for %dedo is at %5lld/%lld\n",
+			edo, reversal + 1, reversal);
+}
+
+void print_blocks(struct sweep* sw) // called with the lock held
+{
+	struct block* b = &sw->blocks[sw->printed % sw->window];
+	while (sw->printed < sw->block_count && b->done) {
+		int first = sw->first + sw->printed * EDO_BLOCK;
+		for (int i = 0; i < EDO_BLOCK && first + i <= sw->last; ++i)
+			print_reversal(first + i, b->reversals[i]);
+		b->done = 0;
+		++sw->printed;
+		b = &sw->blocks[sw->printed % sw->window];
+	}
+	pthread_cond_broadcast(&sw->printed_cond);
+}
+
+void* sweep_worker(void* arg)
+{
+	struct sweep* sw = arg;
+	int* val = malloc(PRIMECOUNT * sizeof(int));
+	int* hm = malloc(((int)SIEVEBOUND + 1) * sizeof(int));
+	long long reversals[EDO_BLOCK];
+	struct stream st;
+	stream_init(&st);
+	pthread_mutex_lock(&sw->lock);
+	for (;;) {
+		while (sw->next_block < sw->block_count
+				&& sw->next_block >= sw->printed + sw->window)
+			pthread_cond_wait(&sw->printed_cond, &sw->lock);
+		if (sw->next_block >= sw->block_count)
+			break;
+		int index = sw->next_block++;
+		pthread_mutex_unlock(&sw->lock);
+		int first = sw->first + index * EDO_BLOCK;
+		block_reversals(first, sw->last - first < EDO_BLOCK
+			? sw->last - first + 1 : EDO_BLOCK, reversals, val, hm, &st);
+		pthread_mutex_lock(&sw->lock);
+		struct block* b = &sw->blocks[index % sw->window];
+		memcpy(b->reversals, reversals, sizeof(reversals));
+		b->done = 1;
+		print_blocks(sw);
+	}
+	pthread_mutex_unlock(&sw->lock);
+	free(val);
+	free(hm);
+	stream_free(&st);
+	return NULL;
+}
+
+int sweep_range(int first, int last, int threads)
+{
+	struct sweep sw = { 0 };
+	if (threads < 1)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+	build_spf();
+	build_base_primes();
+	if (max_harmonic < table_limit)
+		table_limit = (int)max_harmonic;
+	sw.first = first;
+	sw.last = last;
+	sw.block_count = (last - first) / EDO_BLOCK + 1;
+	sw.window = threads * BLOCK_WINDOW;
+	sw.blocks = calloc(sw.window, sizeof(struct block));
+	pthread_mutex_init(&sw.lock, NULL);
+	pthread_cond_init(&sw.printed_cond, NULL);
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, sweep_worker, &sw);
+	for (int i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	free(sw.blocks);
+	return EXIT_SUCCESS;
+}
+
+// the mapping of n with the primes after index at their patent val plus
+// extra, which gives its least or greatest mapping still to come
+int mapping_bound(struct val_search* vs, int n, int index, int extra)
+{
+	int m = 0;
+	for (; n > 1; n = cofactor[n])
+		m += spf_index[n] <= index ? vs->val[spf_index[n]]
+			: vs->patent[spf_index[n]] + extra;
+	return m;
+}
+
+// adds the primes up to index in n to set
+void add_factors(uint64_t* set, int n, int index)
+{
+	for (; n > 1; n = cofactor[n])
+		if (spf_index[n] <= index)
+			set[spf_index[n] / 64] |= (uint64_t)1 << (spf_index[n] % 64);
+}
+
+// picks a val for the index-th prime, cap being the earliest reversal
+// that can't be avoided any more (limit + 1 for none) and because being
+// the primes that made it so. A dead end goes straight back to the latest
+// prime behind it, which is what's returned; -1 when there's none left.
+int search_vals(struct val_search* vs, int index, int cap,
+	const uint64_t* because)
+{
+	int k = vs->k, words = vs->words;
+	uint64_t* conflict = vs->conflicts + (size_t)index * words;
+	uint64_t* reason = vs->reasons + (size_t)index * words;
+	memset(conflict, 0, words * sizeof(uint64_t));
+	vs->chronological[index] = 0;
+	for (int d = 0; d <= 2 * k; ++d) { // patent first, then out either side
+		if (index == 0 && d) // 2 is always the EDO
+			break;
+		vs->val[index] = vs->patent[index] + (d % 2 ? (d + 1) / 2 : -d / 2);
+		// only the pairs with this prime in them have any less leeway
+		int reached = cap, gap = 0;
+		const uint64_t* behind = because;
+		for (int i = vs->pair_start[index]; i < vs->pair_start[index + 1]
+				&& vs->pairs[i] < reached; ++i) {
+			int n = vs->pairs[i];
+			if (mapping_bound(vs, n, index, k)
+					< mapping_bound(vs, n - 1, index, -k))
+				gap = 1;
+			// a prime to come also has to fit between its neighbours
+			else if (spf[n - 1] == n - 1 && spf_index[n - 1] > index
+					&& mapping_bound(vs, n, index, k)
+						< mapping_bound(vs, n - 2, index, -k))
+				gap = 2;
+			if (!gap)
+				continue;
+			memset(reason, 0, words * sizeof(uint64_t));
+			add_factors(reason, n, index);
+			add_factors(reason, n - gap, index);
+			behind = reason;
+			reached = n;
+			gap = 0;
+		}
+		if (reached - 1 <= vs->best) {
+			for (int i = 0; behind && i < words; ++i)
+				conflict[i] |= behind[i];
+			continue;
+		}
+		if (index + 1 == vs->prime_count
+				|| range_primes[index + 1] >= reached) { // nothing else matters
+			vs->best = reached - 1;
+			memcpy(vs->best_val, vs->patent, vs->prime_count * sizeof(int));
+			memcpy(vs->best_val, vs->val, (index + 1) * sizeof(int));
+			vs->chronological[index] = 1;
+			if (reached > vs->limit) {
+				vs->done = 1;
+				return -1;
+			}
+		} else {
+			int back = search_vals(vs, index + 1, reached, behind);
+			if (vs->done || back < index)
+				return back;
+		}
+		// with no multiple below the cap, any other val would only give
+		// the same branch again or a worse one
+		if (reached == cap && 2 * range_primes[index] >= cap) {
+			vs->chronological[index] = 1;
+			break;
+		}
+	}
+	conflict[index / 64] &= ~((uint64_t)1 << (index % 64));
+	int back = index - 1;
+	if (!vs->chronological[index])
+		for (back = index - 1; back >= 0
+				&& !(conflict[back / 64] >> (back % 64) & 1); --back)
+			;
+	if (back < 0)
+		return -1;
+	uint64_t* earlier = vs->conflicts + (size_t)back * words;
+	for (int i = 0; i < words; ++i)
+		earlier[i] |= conflict[i];
+	vs->chronological[back] |= vs->chronological[index];
+	return back;
+}
+
+int best_val(int edo, int k)
+{
+	struct val_search vs = { .edo = edo, .k = k };
+	build_spf();
+	vs.limit = max_harmonic < (long long)SIEVEBOUND
+		? (int)max_harmonic : (int)SIEVEBOUND;
+	while (vs.prime_count < range_prime_count
+			&& range_primes[vs.prime_count] <= vs.limit)
+		++vs.prime_count;
+	vs.pair_start = calloc(vs.prime_count + 1, sizeof(int));
+	for (int i = 0; i < vs.prime_count; ++i) // multiples m give m and m + 1
+		vs.pair_start[i + 1] = vs.pair_start[i] + vs.limit / range_primes[i]
+			+ (vs.limit - 1) / range_primes[i];
+	vs.pairs = malloc(vs.pair_start[vs.prime_count] * sizeof(int));
+	for (int i = 0; i < vs.prime_count; ++i) {
+		int count = vs.pair_start[i];
+		for (int m = range_primes[i]; m <= vs.limit; m += range_primes[i]) {
+			vs.pairs[count++] = m;
+			if (m < vs.limit)
+				vs.pairs[count++] = m + 1;
+		}
+	}
+	vs.patent = malloc(vs.prime_count * sizeof(int));
+	vs.val = malloc(vs.prime_count * sizeof(int));
+	vs.best_val = malloc(vs.prime_count * sizeof(int));
+	for (int i = 0; i < vs.prime_count; ++i)
+		vs.patent[i] = (int)round(log2_primes[i] * edo);
+	vs.words = (vs.prime_count + 63) / 64;
+	vs.conflicts = malloc((size_t)vs.prime_count * vs.words * sizeof(uint64_t));
+	vs.reasons = malloc((size_t)vs.prime_count * vs.words * sizeof(uint64_t));
+	vs.chronological = malloc(vs.prime_count);
+	search_vals(&vs, 0, vs.limit + 1, NULL);
+	if (vs.done)
+		printf("Best val for %dedo has no superparticular reversals up to "
+			"%d/%d\n", edo, vs.limit, vs.limit - 1);
+	else
+		printf("Best val for %dedo first reverses at %5d/%d\n",
+			edo, vs.best + 1, vs.best);
+	int changed = 0;
+	for (int i = 0; i < vs.prime_count; ++i) {
+		if (vs.best_val[i] == vs.patent[i])
+			continue;
+		printf(changed++ ? ", %d%+d" : "Differs from the patent val at %d%+d",
+			range_primes[i], vs.best_val[i] - vs.patent[i]);
+	}
+	printf(changed ? "\n" : "That is the patent val\n");
+	free(vs.pair_start);
+	free(vs.pairs);
+	free(vs.patent);
+	free(vs.val);
+	free(vs.best_val);
+	free(vs.conflicts);
+	free(vs.reasons);
+	free(vs.chronological);
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char** argv)
 {
+	_Bool streamed = 0;
+	for (int i = 1; i < argc - 1; ++i) { // take --max-harmonic out of argv
+		if (strcmp(argv[i], "--max-harmonic"))
+			continue;
+		if (sscanf(argv[i + 1], "%lld", &max_harmonic) != 1
+				|| max_harmonic < 2 || max_harmonic > (1LL << 52)) {
+			printf("--max-harmonic must be from 2 to 2^52\n");
+			return 1;
+		}
+		streamed = 1;
+		for (int j = i + 2; j <= argc; ++j)
+			argv[j - 2] = argv[j];
+		argc -= 2;
+		break;
+	}
+	if (argc > 1 && !strcmp(argv[1], "--best-val")) {
+		int edo = 0, k = 1;
+		if ((argc == 3 || (argc == 5 && !strcmp(argv[3], "-k")))
+				&& sscanf(argv[2], "%d", &edo) == 1
+				&& (argc == 3 || sscanf(argv[4], "%d", &k) == 1)
+				&& edo > 0 && k >= 0)
+			return best_val(edo, k);
+		printf("Usage: ./reversed-intervals --best-val [EDO] [-k steps] "
+			"[--max-harmonic N]\n");
+		return 1;
+	}
+	if (argc > 1 && !strcmp(argv[1], "--range")) {
+		int first = 0, last = 0, threads = 0;
+		if ((argc == 4 || (argc == 6 && !strcmp(argv[4], "-j")))
+				&& sscanf(argv[2], "%d", &first) == 1
+				&& sscanf(argv[3], "%d", &last) == 1
+				&& (argc == 4 || sscanf(argv[5], "%d", &threads) == 1)
+				&& first > 0 && last >= first)
+			return sweep_range(first, last, threads);
+		printf("Usage: ./reversed-intervals --range [first EDO] [last EDO] "
+			"[-j threads] [--max-harmonic N]\n");
+		return 1;
+	}
 	if (argc != 2) {
-		printf("Usage: ./reversed-intervals [EDO]\n");
+		printf("Usage: ./reversed-intervals [EDO] [--max-harmonic N]\n");
+		printf("       ./reversed-intervals --range [first EDO] [last EDO] "
+			"[-j threads] [--max-harmonic N]\n");
+		printf("       ./reversed-intervals --best-val [EDO] [-k steps] "
+			"[--max-harmonic N]\n");
 		return 1;
 	}
 	int edo;
 	sscanf(argv[1], "%d", &edo);
+	if (streamed) { // nothing the size of the bound goes on the stack
+		struct stream st;
+		build_base_primes();
+		stream_init(&st);
+		long long reversal = stream_reversal(edo, 2, 0, &st);
+		stream_free(&st);
+		if (!reversal) {
+			printf("No superparticular reversals found\n");
+			return EXIT_FAILURE;
+		}
+		printf("First superparticular reversal for %dedo is at %5lld/%lld\n",
+			edo, reversal + 1, reversal);
+		return EXIT_SUCCESS;
+	}
 	int primes[PRIMECOUNT];
 	sieve(primes, PRIMECOUNT);
 	int val[PRIMECOUNT];
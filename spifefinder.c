@@ -5,13 +5,89 @@ rational numbers which only have consecutive prime numbers starting with 2 in
 the prime factorizations of their numerator and denominator and have a numerator
 that is exactly one greater than their denominator. These numbers have one or
 more special properties in music as a ratio between two pitches, including
-in regard to tempered tuning systems. */
+in regard to tempered tuning systems.
+
+By default every integer up to the limit is trial divided. With "-m smooth"
+only the smooth numbers are generated instead, in increasing order, and only
+neighbouring pairs of them are checked. They're generated a window at a time
+(each twice as long as the last) by multiplying up from 1 with primes no
+smaller than the last one used, which reaches every smooth number once, and
+each window is sorted before it's handed out.
+
+"-m pell" uses Stormer's method instead, so no limit has to be known in
+advance, and a prime limit past 61 (up to 97) can be given after it. The
+numerator and denominator of every superparticular n+1/n in the limit have
+x = 2n + 1 and y with x^2 - 2qy^2 = 1, where q is a squarefree product of
+primes in the limit and y is smooth. So for each q the fundamental solution
+is found from the continued fraction of sqrt(2q), q is skipped if its y
+isn't smooth (y divides the y of every other solution), and Lehmer showed
+only the first max(3, (p + 1) / 2) solutions can have a smooth y. Everything
+is done in 128 bits, and a q whose solutions pass 2^126 is dropped, so the
+list is complete for numerators below 2^125.
+
+"-m sieve" goes through the integers in segments of SEGMENT, like the
+sieving stage of the quadratic sieve: each prime power adds a scaled and
+rounded up log of its prime to the entries it divides, and only entries
+whose total reaches the log of the segment's start are trial divided.
+Segments are handed out to "-j N" threads (all cores unless it's given) and
+printed in order, and "-c file" saves the position and everything found so
+far every minute so that a stopped search can carry on where it left off.
+
+Every mode makes a single pass up to the largest limit, finding the largest
+prime factor of each pair it comes across once. A pair belongs to the limit
+of that prime and every limit above it, so each limit's table is printed as
+soon as the pass has gone past its range. */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
 
 #define MAX_ZEROS 0 // maximum number of zeros allowed in monzos of results
+#define FIRST_WINDOW 1048576 // smooth numbers below this are generated first
+#define MAX_PRIMES 25 // up to 97, so 2q always fits in 122 bits
+#define PELL_BOUND ((u128)1 << 126) // largest x of a Pell solution tried
+#define GPF_BITS 5 // low bits of a stored smooth number holding its largest prime
+#define SEGMENT 262144 // integers sieved at once, one byte each
+#define SEGMENT_WINDOW 8 // finished segments per thread allowed to await printing
+#define CHECKPOINT_INTERVAL 60 // seconds between checkpoint saves
+
+typedef unsigned __int128 u128;
+
+struct spife // a pair of neighbouring smooth numbers
+{
+	u128 numerator;
+	short gpf; // index of the largest prime in either one
+};
+
+struct pairs
+{
+	struct spife* spifes;
+	long count, size;
+};
+
+struct tables // pairs for every limit, each printed once its range is done
+{
+	short* primes;
+	short primes_length, printed; // printed is the next limit to print
+	long* search_limits; // NULL if every pair is known before printing
+	struct pairs found; // in increasing order
+};
+
+struct smooth_stream // the smooth numbers up to limit, in increasing order
+{
+	short* primes;
+	short primes_length;
+	long limit;
+	long low, high; // bounds of the window in values, high not included
+	long* values; // each shifted up GPF_BITS with its largest prime below
+	long count, next, size;
+};
 
 _Bool divisible(long x, short* primes, short primes_length)
 {
@@ -24,7 +100,21 @@ _Bool divisible(long x, short* primes, short primes_length)
 	return true;
 }
 
-short check_monzo(long x, short* primes, short primes_length)
+short largest_prime(long x, short* primes, short primes_length) // -1 if none
+{
+	short largest = 0;
+	for (short i = 0; i < primes_length && x > 1; ++i) {
+		if (x % *(primes + i) == 0) {
+			largest = i;
+			do
+				x /= *(primes + i);
+			while (x % *(primes + i) == 0);
+		}
+	}
+	return x == 1 ? largest : -1;
+}
+
+short check_monzo(u128 x, short* primes, short primes_length)
 {
 	short total = 0;
 	for (short i = 0; i < primes_length; ++i) {
@@ -34,10 +124,10 @@ short check_monzo(long x, short* primes, short primes_length)
 	return total;
 }
 
-void show_monzo(long x, short* primes, short primes_length)
+void show_monzo(u128 x, short* primes, short primes_length)
 {
 	short exp;
-	long y = x - 1;
+	u128 y = x - 1;
 	printf("[");
 	for (short i = 0; i < primes_length; ++i) {
 		exp = 0;
@@ -56,7 +146,467 @@ void show_monzo(long x, short* primes, short primes_length)
 	printf(">\n");
 }
 
-int main()
+void add_smooth(struct smooth_stream* ss, long x)
+{
+	if (ss->count == ss->size) {
+		ss->size = ss->size ? 2 * ss->size : 4096;
+		ss->values = realloc(ss->values, ss->size * sizeof(long));
+	}
+	*(ss->values + ss->count++) = x;
+}
+
+// x and its multiples by primes from the ith on that fall in the window
+void collect_smooth(struct smooth_stream* ss, long x, short i)
+{
+	if (x >= ss->low)
+		add_smooth(ss, x << GPF_BITS | i);
+	for (short j = i; j < ss->primes_length; ++j) {
+		if (x > (ss->high - 1) / *(ss->primes + j))
+			break;
+		collect_smooth(ss, x * *(ss->primes + j), j);
+	}
+}
+
+int compare_longs(const void* a, const void* b)
+{
+	long x = *(const long*)a, y = *(const long*)b;
+	return (x > y) - (x < y);
+}
+
+void start_smooth(struct smooth_stream* ss, short* primes,
+	short primes_length, long limit)
+{
+	ss->primes = primes;
+	ss->primes_length = primes_length;
+	ss->limit = limit;
+	ss->low = ss->high = 1;
+	ss->count = ss->next = 0;
+}
+
+// 0 once they've run out, and the index of the largest prime in gpf
+long next_smooth(struct smooth_stream* ss, short* gpf)
+{
+	while (ss->next == ss->count) {
+		if (ss->high > ss->limit)
+			return 0;
+		ss->low = ss->high;
+		ss->high = ss->low < FIRST_WINDOW ? FIRST_WINDOW : 2 * ss->low;
+		if (ss->high > ss->limit)
+			ss->high = ss->limit + 1;
+		ss->count = ss->next = 0;
+		collect_smooth(ss, 1, 0);
+		qsort(ss->values, ss->count, sizeof(long), compare_longs);
+	}
+	long x = *(ss->values + ss->next++);
+	*gpf = (short)(x & ((1 << GPF_BITS) - 1));
+	return x >> GPF_BITS;
+}
+
+void print_u128(u128 x)
+{
+	char digits[40];
+	int len = 0;
+	do {
+		digits[len++] = '0' + (int)(x % 10);
+		x /= 10;
+	} while (x);
+	while (len)
+		putchar(digits[--len]);
+}
+
+void print_spife(u128 j, short* primes, short primes_length)
+{
+	if (check_monzo(j, primes, primes_length) < 1 + MAX_ZEROS) {
+		printf("\t");
+		print_u128(j);
+		printf("/");
+		print_u128(j - 1);
+		printf("\t");
+		show_monzo(j, primes, primes_length);
+	}
+}
+
+void add_pair(struct pairs* found, u128 numerator, short gpf)
+{
+	if (found->count == found->size) {
+		found->size = found->size ? 2 * found->size : 256;
+		found->spifes = realloc(found->spifes,
+			found->size * sizeof(struct spife));
+	}
+	(found->spifes + found->count)->numerator = numerator;
+	(found->spifes + found->count++)->gpf = gpf;
+}
+
+void start_tables(struct tables* t, short* primes, short primes_length,
+	long* search_limits)
+{
+	t->primes = primes;
+	t->primes_length = primes_length;
+	t->printed = 1; // 2/1 is the only 2-limit pair, and it's never listed
+	t->search_limits = search_limits;
+	t->found.count = 0;
+}
+
+// prints every limit whose whole range is below reached, in order
+void print_tables(struct tables* t, u128 reached)
+{
+	while (t->printed < t->primes_length && (!t->search_limits
+			|| (u128)*(t->search_limits + t->printed) < reached)) {
+		short i = t->printed++;
+		printf("%d-limit:\n", *(t->primes + i));
+		for (long j = 0; j < t->found.count; ++j)
+			if ((t->found.spifes + j)->gpf <= i)
+				print_spife((t->found.spifes + j)->numerator, t->primes, i + 1);
+		fflush(stdout);
+	}
+}
+
+void trial_search(short* primes, short primes_length, long* search_limits)
+{
+	struct tables t = { 0 };
+	long last = *(search_limits + primes_length - 1);
+	short gpf, previous = -1;
+	start_tables(&t, primes, primes_length, search_limits);
+	for (long j = 2; j <= last; ++j) {
+		gpf = largest_prime(j, primes, primes_length);
+		if (gpf >= 0 && previous >= 0 && j > 2)
+			add_pair(&t.found, j, gpf > previous ? gpf : previous);
+		previous = gpf;
+		print_tables(&t, j);
+	}
+	print_tables(&t, (u128)last + 1);
+	free(t.found.spifes);
+}
+
+void smooth_search(short* primes, short primes_length, long* search_limits)
+{
+	struct smooth_stream ss = { 0 };
+	struct tables t = { 0 };
+	long j, previous = 0;
+	short gpf, previous_gpf = 0;
+	start_tables(&t, primes, primes_length, search_limits);
+	start_smooth(&ss, primes, primes_length,
+		*(search_limits + primes_length - 1));
+	while ((j = next_smooth(&ss, &gpf))) {
+		if (j == previous + 1 && previous > 1)
+			add_pair(&t.found, j, gpf > previous_gpf ? gpf : previous_gpf);
+		previous = j;
+		previous_gpf = gpf;
+		print_tables(&t, j);
+	}
+	print_tables(&t, (u128)ss.limit + 1);
+	free(ss.values);
+	free(t.found.spifes);
+}
+
+short largest_prime_u128(u128 x, short* primes, short primes_length)
+{
+	short largest = 0;
+	for (short i = 0; i < primes_length && x > 1; ++i) {
+		if (x % *(primes + i) == 0) {
+			largest = i;
+			do
+				x /= *(primes + i);
+			while (x % *(primes + i) == 0);
+		}
+	}
+	return x == 1 ? largest : -1;
+}
+
+u128 isqrt(u128 x)
+{
+	u128 r = (u128)sqrtl((long double)x);
+	while (r * r > x)
+		--r;
+	while ((r + 1) * (r + 1) <= x)
+		++r;
+	return r;
+}
+
+// the smallest x, y > 0 with x^2 - D y^2 = 1, or false if x passes PELL_BOUND
+_Bool pell_fundamental(u128 D, u128* x, u128* y)
+{
+	unsigned long a0 = (unsigned long)isqrt(D), a = a0, m = 0, d = 1;
+	u128 p = a0, p_last = 1, q = 1, q_last = 0, t;
+	if ((u128)a0 * a0 == D)
+		return false;
+	for (long k = 0;; ++k) {
+		// p/q is the kth convergent and p^2 - D q^2 = (-1)^(k+1) d after this
+		m = d * a - m;
+		d = (unsigned long)((D - (u128)m * m) / d);
+		a = (a0 + m) / d;
+		if (d == 1 && k % 2) {
+			*x = p;
+			*y = q;
+			return true;
+		}
+		if (p > (PELL_BOUND - p_last) / a)
+			return false;
+		t = a * p + p_last;
+		p_last = p;
+		p = t;
+		t = a * q + q_last;
+		q_last = q;
+		q = t;
+	}
+}
+
+// every solution of x^2 - 2qy^2 = 1 that can give a smooth pair
+void pell_pairs(u128 q, short* primes, short primes_length,
+	struct pairs* found)
+{
+	u128 D = 2 * q, x1, y1, x, y, t, u;
+	int tries = (*(primes + primes_length - 1) + 1) / 2;
+	if (!pell_fundamental(D, &x1, &y1)
+			|| largest_prime_u128(y1, primes, primes_length) < 0)
+		return;
+	x = x1;
+	y = y1;
+	for (int k = 1; k <= (tries > 3 ? tries : 3); ++k) {
+		if (x % 2 && y % 2 == 0 && x > 3
+				&& largest_prime_u128(y, primes, primes_length) >= 0)
+			add_pair(found, (x + 1) / 2, 0); // x = 3 gives 2/1, never listed
+		// x + y sqrt(D) times x1 + y1 sqrt(D)
+		if (__builtin_mul_overflow(x1, x, &t) || __builtin_mul_overflow(y1, y, &u)
+				|| __builtin_mul_overflow(u, D, &u)
+				|| __builtin_add_overflow(t, u, &t) || t > PELL_BOUND)
+			break;
+		y = x1 * y + y1 * x;
+		x = t;
+	}
+}
+
+// each squarefree q from the ith prime on, times the product so far
+void pell_subsets(u128 q, short i, short* primes, short primes_length,
+	struct pairs* found)
+{
+	if (i == primes_length) {
+		pell_pairs(q, primes, primes_length, found);
+		return;
+	}
+	pell_subsets(q, i + 1, primes, primes_length, found);
+	pell_subsets(q * *(primes + i), i + 1, primes, primes_length, found);
+}
+
+int compare_spifes(const void* a, const void* b)
+{
+	u128 x = ((const struct spife*)a)->numerator;
+	u128 y = ((const struct spife*)b)->numerator;
+	return (x > y) - (x < y);
+}
+
+void pell_search(short* primes, short primes_length)
+{
+	struct tables t = { 0 };
+	short a, b;
+	start_tables(&t, primes, primes_length, NULL);
+	pell_subsets(1, 0, primes, primes_length, &t.found);
+	qsort(t.found.spifes, t.found.count, sizeof(struct spife), compare_spifes);
+	for (long j = 0; j < t.found.count; ++j) {
+		struct spife* sp = t.found.spifes + j;
+		a = largest_prime_u128(sp->numerator, primes, primes_length);
+		b = largest_prime_u128(sp->numerator - 1, primes, primes_length);
+		sp->gpf = a > b ? a : b;
+	}
+	print_tables(&t, 0);
+	free(t.found.spifes);
+}
+
+struct segment
+{
+	struct pairs found;
+	_Bool done;
+};
+
+struct sieve_scan // the whole search, shared by the threads
+{
+	short* primes;
+	short primes_length;
+	unsigned char logs[MAX_PRIMES]; // scaled log2 of each prime, rounded up
+	double scale;
+	long start, end, segment_count, next_segment, merged;
+	int window;
+	struct segment* segments; // ring buffer of window slots
+	struct tables* tables;
+	const char* checkpoint;
+	time_t last_save;
+	pthread_mutex_t lock;
+	pthread_cond_t merged_cond;
+};
+
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+// adds n to found for every n in [first, last) with n - 1 and n both smooth
+void sieve_segment(struct sieve_scan* sc, long first, long last,
+	unsigned char* sums, struct pairs* found)
+{
+	long base = first - 1, len = last - base;
+	unsigned char threshold = (unsigned char)(sc->scale * log2((double)base));
+	memset(sums, 0, len);
+	for (short i = 0; i < sc->primes_length; ++i) {
+		long p = *(sc->primes + i);
+		for (long pe = p; pe < last; pe *= p) {
+			for (long k = (pe - base % pe) % pe; k < len; k += pe)
+				sums[k] += sc->logs[i];
+			if (pe > (last - 1) / p)
+				break;
+		}
+	}
+	short gpf, previous = -1;
+	for (long k = 0; k < len; ++k) {
+		gpf = sums[k] >= threshold
+			? largest_prime(base + k, sc->primes, sc->primes_length) : -1;
+		if (gpf >= 0 && previous >= 0)
+			add_pair(found, base + k, gpf > previous ? gpf : previous);
+		previous = gpf;
+	}
+}
+
+void save_sieve_checkpoint(struct sieve_scan* sc)
+{
+	char tmp[strlen(sc->checkpoint) + 5];
+	sprintf(tmp, "%s.tmp", sc->checkpoint);
+	FILE* f = fopen(tmp, "w");
+	if (!f) {
+		perror(tmp);
+		return;
+	}
+	long next = sc->start + sc->merged * SEGMENT;
+	struct pairs* found = &sc->tables->found;
+	fprintf(f, "%ld\n", next < sc->end ? next : sc->end);
+	for (long j = 0; j < found->count; ++j)
+		fprintf(f, "%ld %d\n", (long)(found->spifes + j)->numerator,
+			(found->spifes + j)->gpf);
+	if (fclose(f) == 0)
+		rename(tmp, sc->checkpoint);
+	sc->last_save = time(NULL);
+}
+
+void merge_segments(struct sieve_scan* sc) // called with the lock held
+{
+	struct segment* sg = &sc->segments[sc->merged % sc->window];
+	while (sc->merged < sc->segment_count && sg->done) {
+		for (long i = 0; i < sg->found.count; ++i)
+			add_pair(&sc->tables->found, (sg->found.spifes + i)->numerator,
+				(sg->found.spifes + i)->gpf);
+		sg->found.count = 0;
+		sg->done = 0;
+		++sc->merged;
+		sg = &sc->segments[sc->merged % sc->window];
+	}
+	long next = sc->start + sc->merged * SEGMENT;
+	print_tables(sc->tables, next < sc->end ? next : sc->end);
+	if (sc->checkpoint && time(NULL) - sc->last_save >= CHECKPOINT_INTERVAL)
+		save_sieve_checkpoint(sc);
+	pthread_cond_broadcast(&sc->merged_cond);
+}
+
+void* sieve_worker(void* arg)
+{
+	struct sieve_scan* sc = arg;
+	struct pairs found = { 0 };
+	unsigned char* sums = malloc(SEGMENT + 1);
+	pthread_mutex_lock(&sc->lock);
+	for (;;) {
+		while (sc->next_segment < sc->segment_count
+				&& sc->next_segment >= sc->merged + sc->window)
+			pthread_cond_wait(&sc->merged_cond, &sc->lock);
+		if (sc->next_segment >= sc->segment_count || stop_requested)
+			break;
+		long index = sc->next_segment++;
+		pthread_mutex_unlock(&sc->lock);
+		long first = sc->start + index * SEGMENT;
+		long last = sc->end - first > SEGMENT ? first + SEGMENT : sc->end;
+		found.count = 0;
+		sieve_segment(sc, first, last, sums, &found);
+		pthread_mutex_lock(&sc->lock);
+		struct segment* sg = &sc->segments[index % sc->window];
+		for (long i = 0; i < found.count; ++i)
+			add_pair(&sg->found, (found.spifes + i)->numerator,
+				(found.spifes + i)->gpf);
+		sg->done = 1;
+		merge_segments(sc);
+	}
+	pthread_mutex_unlock(&sc->lock);
+	free(found.spifes);
+	free(sums);
+	return NULL;
+}
+
+// the numerator to carry on from, and everything found before it
+_Bool load_sieve_checkpoint(const char* checkpoint, long* next,
+	struct pairs* found)
+{
+	FILE* f = fopen(checkpoint, "r");
+	long n;
+	int gpf;
+	if (!f)
+		return false;
+	if (fscanf(f, "%ld", next) != 1) {
+		fclose(f);
+		return false;
+	}
+	while (fscanf(f, "%ld %d", &n, &gpf) == 2)
+		add_pair(found, n, (short)gpf);
+	fclose(f);
+	return true;
+}
+
+int sieve_search(short* primes, short primes_length, long* search_limits,
+	int threads, const char* checkpoint)
+{
+	struct sieve_scan sc = { 0 };
+	struct tables t = { 0 };
+	start_tables(&t, primes, primes_length, search_limits);
+	sc.start = 3; // 2/1 is never listed
+	if (checkpoint && load_sieve_checkpoint(checkpoint, &sc.start, &t.found))
+		fprintf(stderr, "Resuming from %ld\n", sc.start);
+	if (threads < 1)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+	sc.primes = primes;
+	sc.primes_length = primes_length;
+	sc.tables = &t;
+	sc.checkpoint = checkpoint;
+	sc.last_save = time(NULL);
+	sc.end = *(search_limits + primes_length - 1) + 1;
+	// leave room for the rounding up, one unit per prime power
+	sc.scale = (250.0 - log2((double)sc.end)) / log2((double)sc.end);
+	for (short j = 0; j < primes_length; ++j)
+		sc.logs[j] = (unsigned char)ceil(sc.scale * log2(*(primes + j)));
+	sc.segment_count = sc.end > sc.start
+		? (sc.end - sc.start + SEGMENT - 1) / SEGMENT : 0;
+	sc.window = threads * SEGMENT_WINDOW;
+	sc.segments = calloc(sc.window, sizeof(struct segment));
+	print_tables(&t, sc.start);
+	pthread_mutex_init(&sc.lock, NULL);
+	pthread_cond_init(&sc.merged_cond, NULL);
+	signal(SIGINT, request_stop); // finish the segments in progress and save
+	signal(SIGTERM, request_stop);
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, sieve_worker, &sc);
+	for (int i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	if (checkpoint)
+		save_sieve_checkpoint(&sc);
+	if (sc.merged == sc.segment_count)
+		print_tables(&t, sc.end);
+	for (int i = 0; i < sc.window; ++i)
+		free(sc.segments[i].found.spifes);
+	free(sc.segments);
+	free(t.found.spifes);
+	return sc.merged == sc.segment_count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
 {
 	short primes_length = 18; // change to match length of following arrays
 	short primes[] = { // add or remove primes to check other subgroups/limits
@@ -68,24 +618,47 @@ int main()
 		1611308700, 3463200000, 63927525376, 421138799640, 1109496723126,
 		1453579866025, 20628591204481, 31887350832897
 	};
-	short consecutive;
-	for (short i = 1; i < primes_length; ++i) {
-		printf("%d-limit:\n", *(primes + i));
-		consecutive = 0;
-		for (long j = 2; j <= *(search_limits + i); ++j) {
-			if (divisible(j, primes, i + 1)) {
-				++consecutive;
+	if (argc == 3 && !strcmp(*(argv + 1), "-m") && !strcmp(*(argv + 2), "smooth")) {
+		smooth_search(primes, primes_length, search_limits);
+		return 0;
+	}
+	if ((argc == 3 || argc == 4) && !strcmp(*(argv + 1), "-m")
+			&& !strcmp(*(argv + 2), "pell")) {
+		short limit = argc == 4 ? (short)atoi(*(argv + 3)) : 61;
+		short pell_primes[MAX_PRIMES], pell_length = 0;
+		if (limit < 3 || limit > 97) {
+			printf("The prime limit has to be from 3 to 97\n");
+			return 1;
+		}
+		for (short p = 2; p <= limit; ++p)
+			if (!divisible(p, pell_primes, pell_length)) // no smaller factors
+				*(pell_primes + pell_length++) = p;
+		pell_search(pell_primes, pell_length);
+		return 0;
+	}
+	if (argc > 2 && !strcmp(*(argv + 1), "-m") && !strcmp(*(argv + 2), "sieve")) {
+		int threads = 0; // all cores
+		const char* checkpoint = NULL;
+		for (int i = 3; i < argc; ++i) {
+			if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+				threads = atoi(argv[++i]);
+			} else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+				checkpoint = argv[++i];
 			} else {
-				consecutive = 0;
-			}
-			if (consecutive == 2) {
-				if (check_monzo(j, primes, i + 1) < 1 + MAX_ZEROS) {
-					printf("\t%ld/%ld\t", j, j - 1);
-					show_monzo(j, primes, i + 1);
-				}
-				--consecutive;
+				argc = 0; // falls through to the usage message
+				break;
 			}
 		}
+		if (argc)
+			return sieve_search(primes, primes_length, search_limits,
+				threads, checkpoint);
+	}
+	if (argc != 1) {
+		printf("Usage: ./spifefinder [-m smooth]\n");
+		printf("       ./spifefinder -m pell [prime limit]\n");
+		printf("       ./spifefinder -m sieve [-j threads] [-c file]\n");
+		return 1;
 	}
+	trial_search(primes, primes_length, search_limits);
 	return 0;
 }
@@ -0,0 +1,429 @@
+/*
+Finds every EDO in a range whose patent val tempers out all of a list of
+commas, meaning the val maps each comma to 0 steps.
+
+The commas are read as dense monzos, either text rows like "[-4 4 -1>" on
+standard input or the binary file written by "monzocalc -b". For text rows
+the primes are given with "-l limit" or "-g 2.3.7", or are otherwise the
+first primes, as many as the first row has exponents. For example:
+
+	echo "81/80 126/125" | ./monzocalc -l 7 - | ./tempering-edos 1 100000
+
+EDOs are checked 64 at a time. The vals of a block are worked out for
+every prime at once and stored one prime after another, so each comma is a
+row times that block, done with as many EDOs per instruction as the CPU
+allows. Most EDOs fail the first comma, so a block stops as soon as none of
+its EDOs are left.
+
+With "-w" the vals with one prime mapped the other way from its patent
+mapping are checked too, and listed in wart notation after the EDO, like
+"12c" for the val of 12-EDO with 5 mapped to 27 steps instead of 28.
+
+The vals and products are whole numbers held in doubles, so they're exact
+as long as they stay below 2^53, far beyond any EDO worth checking.
+
+Compile with: cc -O2 tempering-edos.c -lm
+
+Public domain code
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define BLOCK 64 // EDOs checked together
+#define MAX_PRIMES 256 // primes in the subgroup
+#define MAX_COMMAS 1024
+#define WART_LETTERS 26 // primes up to 101 get a letter, a for 2, b for 3...
+#define DENSE_MAGIC "MONZODNS"
+
+// the first 64 bytes of a binary file from monzocalc, which has the same
+// struct; the two have to be kept the same
+struct dense_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t width; // bytes per exponent, 1 or 2
+	uint64_t rows;
+	uint32_t cols;
+	uint32_t reserved;
+	uint64_t primes_offset;
+	uint64_t data_offset;
+	uint64_t flags_offset;
+	uint64_t column_stride;
+};
+
+unsigned long primes[MAX_PRIMES];
+double logs[MAX_PRIMES]; // log2 of each prime
+int cols;
+double* commas; // one row of cols exponents per comma
+int comma_count;
+// vals of 64 EDOs from first for every prime, and the products with each comma
+unsigned long (*temper_block)(long first, double* vals, double* dots, _Bool all);
+
+_Bool is_prime(unsigned long n)
+{
+	if (n < 2)
+		return 0;
+	for (unsigned long i = 2; i * i <= n; ++i)
+		if (n % i == 0)
+			return 0;
+	return 1;
+}
+
+/* Each kernel fills vals with round(n * log2(p)) for the 64 EDOs and every
+prime, rounding halves up like round() does in generate_val, then takes the
+product of each comma with those vals. A bit is set in the result for each
+EDO that tempers out every comma checked. With all set, every comma is
+checked and its products kept for the warts, otherwise it stops once no
+EDOs are left. */
+
+unsigned long temper_block_portable(long first, double* vals, double* dots,
+	_Bool all)
+{
+	unsigned long survivors = ~0UL, bits;
+	double d;
+	for (int j = 0; j < cols; ++j)
+		for (int k = 0; k < BLOCK; ++k)
+			vals[j * BLOCK + k] = round((double)(first + k) * logs[j]);
+	for (int i = 0; i < comma_count && (survivors || all); ++i) {
+		bits = 0;
+		for (int k = 0; k < BLOCK; ++k) {
+			d = 0.0;
+			for (int j = 0; j < cols; ++j)
+				d += commas[i * cols + j] * vals[j * BLOCK + k];
+			dots[i * BLOCK + k] = d;
+			if (d == 0.0)
+				bits |= 1UL << k;
+		}
+		survivors &= bits;
+	}
+	return survivors;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+unsigned long temper_block_avx2(long first, double* vals, double* dots,
+	_Bool all)
+{
+	unsigned long survivors = ~0UL, bits;
+	__m256d zero = _mm256_setzero_pd(), four = _mm256_set1_pd(4.0), n, d;
+	__m256d half = _mm256_set1_pd(0.5), one = _mm256_set1_pd(1.0), x, f;
+	for (int j = 0; j < cols; ++j) {
+		__m256d l = _mm256_set1_pd(logs[j]);
+		n = _mm256_set_pd(first + 3, first + 2, first + 1, first);
+		for (int k = 0; k < BLOCK; k += 4) {
+			x = _mm256_mul_pd(n, l);
+			f = _mm256_floor_pd(x); // x - f is exact, so this is round(x)
+			_mm256_storeu_pd(vals + j * BLOCK + k, _mm256_add_pd(f,
+				_mm256_and_pd(one, _mm256_cmp_pd(_mm256_sub_pd(x, f), half,
+				_CMP_GE_OQ))));
+			n = _mm256_add_pd(n, four);
+		}
+	}
+	for (int i = 0; i < comma_count && (survivors || all); ++i) {
+		bits = 0;
+		for (int k = 0; k < BLOCK; k += 4) {
+			d = zero;
+			for (int j = 0; j < cols; ++j)
+				d = _mm256_add_pd(d, _mm256_mul_pd(
+					_mm256_set1_pd(commas[i * cols + j]),
+					_mm256_loadu_pd(vals + j * BLOCK + k)));
+			_mm256_storeu_pd(dots + i * BLOCK + k, d);
+			bits |= (unsigned long)_mm256_movemask_pd(
+				_mm256_cmp_pd(d, zero, _CMP_EQ_OQ)) << k;
+		}
+		survivors &= bits;
+	}
+	return survivors;
+}
+
+__attribute__((target("avx512f")))
+unsigned long temper_block_avx512(long first, double* vals, double* dots,
+	_Bool all)
+{
+	unsigned long survivors = ~0UL, bits;
+	__m512d zero = _mm512_setzero_pd(), eight = _mm512_set1_pd(8.0), n, d;
+	__m512d half = _mm512_set1_pd(0.5), one = _mm512_set1_pd(1.0), x, f;
+	for (int j = 0; j < cols; ++j) {
+		__m512d l = _mm512_set1_pd(logs[j]);
+		n = _mm512_set_pd(first + 7, first + 6, first + 5, first + 4,
+			first + 3, first + 2, first + 1, first);
+		for (int k = 0; k < BLOCK; k += 8) {
+			x = _mm512_mul_pd(n, l);
+			f = _mm512_roundscale_pd(x, _MM_FROUND_TO_NEG_INF);
+			_mm512_storeu_pd(vals + j * BLOCK + k, _mm512_mask_add_pd(f,
+				_mm512_cmp_pd_mask(_mm512_sub_pd(x, f), half, _CMP_GE_OQ),
+				f, one));
+			n = _mm512_add_pd(n, eight);
+		}
+	}
+	for (int i = 0; i < comma_count && (survivors || all); ++i) {
+		bits = 0;
+		for (int k = 0; k < BLOCK; k += 8) {
+			d = zero;
+			for (int j = 0; j < cols; ++j)
+				d = _mm512_add_pd(d, _mm512_mul_pd(
+					_mm512_set1_pd(commas[i * cols + j]),
+					_mm512_loadu_pd(vals + j * BLOCK + k)));
+			_mm512_storeu_pd(dots + i * BLOCK + k, d);
+			bits |= (unsigned long)_mm512_cmp_pd_mask(d, zero, _CMP_EQ_OQ)
+				<< k;
+		}
+		survivors &= bits;
+	}
+	return survivors;
+}
+#endif
+
+void choose_kernel(void)
+{
+	temper_block = temper_block_portable;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx512f"))
+		temper_block = temper_block_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		temper_block = temper_block_avx2;
+#endif
+}
+
+// letter of the prime in wart notation, or 0 if it's past z
+char wart_letter(unsigned long p)
+{
+	int index = 0;
+	for (unsigned long i = 2; i < p && index < WART_LETTERS; ++i)
+		index += is_prime(i);
+	return index < WART_LETTERS ? 'a' + index : 0;
+}
+
+/* Moving prime j to its other mapping changes the val by +1 if n * log2(p)
+was rounded down and -1 if it was rounded up, which changes each product by
+that times the comma's exponent of p. */
+
+void print_warts(long edo, int k, const double* vals, const double* dots)
+{
+	for (int j = 0; j < cols; ++j) {
+		char letter = wart_letter(primes[j]);
+		double exact = (double)edo * logs[j];
+		double shift = exact > vals[j * BLOCK + k] ? 1.0 : -1.0;
+		int i = 0;
+		if (exact == vals[j * BLOCK + k]) // the octave has no other mapping
+			continue;
+		while (i < comma_count
+				&& dots[i * BLOCK + k] + shift * commas[i * cols + j] == 0.0)
+			++i;
+		if (letter && i == comma_count)
+			printf("%ld%c\n", edo, letter);
+	}
+}
+
+void search(long first, long last, _Bool warts)
+{
+	double* vals = malloc(cols * BLOCK * sizeof(double));
+	double* dots = malloc(comma_count * BLOCK * sizeof(double));
+	unsigned long survivors;
+	for (long edo = first; edo <= last; edo += BLOCK) {
+		survivors = temper_block(edo, vals, dots, warts);
+		if (last - edo < BLOCK - 1)
+			survivors &= (1UL << (last - edo + 1)) - 1;
+		for (int k = 0; k < BLOCK && (survivors || warts); ++k) {
+			if (edo + k > last)
+				break;
+			if ((survivors >> k) & 1)
+				printf("%ld\n", edo + k);
+			if (warts)
+				print_warts(edo + k, k, vals, dots);
+		}
+	}
+	free(vals);
+	free(dots);
+}
+
+void add_comma(const double* exps)
+{
+	if (comma_count == MAX_COMMAS) {
+		fprintf(stderr, "Only the first %d commas are used\n", MAX_COMMAS);
+		return;
+	}
+	memcpy(commas + comma_count++ * cols, exps, cols * sizeof(double));
+}
+
+// rows like "[-4 4 -1>" from standard input, anything else is skipped
+int read_text(void)
+{
+	char line[4096];
+	double exps[MAX_PRIMES];
+	while (fgets(line, sizeof(line), stdin)) {
+		char* s = strchr(line, '[');
+		char* end;
+		int n = 0;
+		if (!s)
+			continue;
+		for (++s; n < MAX_PRIMES; ++n) {
+			long e = strtol(s, &end, 10);
+			if (end == s)
+				break;
+			exps[n] = (double)e;
+			s = end;
+		}
+		if (*s != '>')
+			continue;
+		if (!cols) { // the first primes, as many as this row needs
+			for (unsigned long p = 2; cols < n; ++p)
+				if (is_prime(p))
+					primes[cols++] = p;
+		}
+		if (n != cols) {
+			fprintf(stderr, "Skipping a row with %d exponents, not %d\n",
+				n, cols);
+			continue;
+		}
+		if (!commas)
+			commas = malloc(MAX_COMMAS * cols * sizeof(double));
+		add_comma(exps);
+	}
+	return 0;
+}
+
+// whether count pieces of size bytes from offset lie within the file
+_Bool section_fits(unsigned long file_size, unsigned long offset,
+	unsigned long count, unsigned long size)
+{
+	if (offset > file_size)
+		return 0;
+	if (!count || !size)
+		return 1;
+	return size <= (file_size - offset) / count;
+}
+
+// the binary file from "monzocalc -b", mapped rather than read
+int read_binary(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(path);
+		return 1;
+	}
+	const unsigned char* file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+		fd, 0);
+	close(fd);
+	const struct dense_header* h = (const struct dense_header*)file;
+	unsigned long size = st.st_size;
+	if (file == MAP_FAILED || size < sizeof(*h)
+			|| memcmp(h->magic, DENSE_MAGIC, 8) || h->cols > MAX_PRIMES
+			|| (h->width != 1 && h->width != 2)
+			|| !section_fits(size, h->primes_offset, h->cols, sizeof(uint64_t))
+			|| !section_fits(size, h->flags_offset, 1, h->rows)
+			|| h->column_stride < h->rows * h->width
+			|| !section_fits(size, h->data_offset, h->cols, h->column_stride)) {
+		fprintf(stderr, "%s isn't a dense monzo file\n", path);
+		return 1;
+	}
+	cols = h->cols;
+	for (int j = 0; j < cols; ++j) {
+		uint64_t p;
+		memcpy(&p, file + h->primes_offset + j * sizeof(p), sizeof(p));
+		primes[j] = p;
+	}
+	commas = malloc(MAX_COMMAS * cols * sizeof(double));
+	double exps[MAX_PRIMES];
+	for (unsigned long i = 0; i < h->rows; ++i) {
+		if (file[h->flags_offset + i]) // not a ratio, or not in the subgroup
+			continue;
+		for (int j = 0; j < cols; ++j) {
+			const unsigned char* column = file + h->data_offset
+				+ j * h->column_stride;
+			int16_t e;
+			if (h->width == 1)
+				e = (signed char)column[i];
+			else
+				memcpy(&e, column + 2 * i, sizeof(e));
+			exps[j] = e;
+		}
+		add_comma(exps);
+	}
+	munmap((void*)file, st.st_size);
+	return 0;
+}
+
+// reads "2.3.7" style subgroups or, with limit set, every prime up to it
+int parse_subgroup(const char* s, _Bool limit)
+{
+	char* end;
+	if (limit) {
+		unsigned long l = strtoul(s, &end, 10);
+		for (unsigned long p = 2; p <= l && cols < MAX_PRIMES; ++p)
+			if (is_prime(p))
+				primes[cols++] = p;
+		return !*end && cols;
+	}
+	for (;;) {
+		unsigned long p = strtoul(s, &end, 10);
+		if (end == s || !is_prime(p) || cols == MAX_PRIMES)
+			return 0;
+		primes[cols++] = p;
+		if (*end != '.')
+			return !*end;
+		s = end + 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* binary = NULL;
+	long first = 0, last = 0;
+	int positional = 0;
+	_Bool warts = 0;
+	for (int i = 1; i < argc; ++i) {
+		if ((!strcmp(argv[i], "-l") || !strcmp(argv[i], "-g")) && i + 1 < argc
+				&& !cols) {
+			if (!parse_subgroup(argv[i + 1], argv[i][1] == 'l')) {
+				printf("Bad subgroup: %s\n", argv[i + 1]);
+				return 1;
+			}
+			++i;
+		} else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+			binary = argv[++i];
+		} else if (!strcmp(argv[i], "-w")) {
+			warts = 1;
+		} else if (positional < 2
+				&& sscanf(argv[i], "%ld", positional ? &last : &first) == 1) {
+			++positional;
+		} else {
+			positional = 0;
+			break;
+		}
+	}
+	if (positional != 2 || first < 1 || last < first) {
+		printf("Usage: ./tempering-edos [-l limit | -g 2.3.7] [-w] "
+			"first_edo last_edo < monzos\n");
+		printf("       ./tempering-edos -b monzo_file [-w] first_edo last_edo\n");
+		return 1;
+	}
+	if (binary) {
+		cols = 0; // the file has its own primes
+		if (read_binary(binary))
+			return 1;
+	} else {
+		read_text();
+	}
+	if (!comma_count) {
+		printf("No commas given\n");
+		return 1;
+	}
+	for (int j = 0; j < cols; ++j)
+		logs[j] = log((double)primes[j]) / log(2.0); // as generate_val has it
+	choose_kernel();
+	search(first, last, warts);
+	return 0;
+}